@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+/// Heap array sized at runtime, aligned to `alignment` bytes so rows start
+/// on cache lines and vector loads don't straddle them. Elements are value
+/// initialized. Movable but not copyable, to keep chunk sized copies
+/// explicit.
+template <typename T, std::size_t alignment = 64>
+class AlignedArray
+{
+public:
+	/// Creates an empty array.
+	AlignedArray() {};
+
+	/// Creates an array of `count` value initialized elements.
+	AlignedArray(std::size_t count) : count(count)
+	{
+		if (!count)
+			return;
+
+		elements = static_cast<T *>(::operator new(
+			count * sizeof(T), std::align_val_t(alignment)));
+		for (std::size_t i = 0; i < count; i++)
+			new (elements + i) T();
+	};
+
+	AlignedArray(const AlignedArray &) = delete;
+	AlignedArray &operator=(const AlignedArray &) = delete;
+
+	AlignedArray(AlignedArray &&other) :
+		elements(std::exchange(other.elements, nullptr)),
+		count(std::exchange(other.count, 0)) {};
+
+	AlignedArray &operator=(AlignedArray &&other)
+	{
+		if (this != &other)
+		{
+			release();
+			elements = std::exchange(other.elements, nullptr);
+			count = std::exchange(other.count, 0);
+		}
+		return *this;
+	};
+
+	~AlignedArray()
+	{
+		release();
+	};
+
+	/// Returns the element at `i`. Throws std::out_of_range if out of
+	/// bounds.
+	T &at(std::size_t i)
+	{
+		if (i >= count)
+			throw std::out_of_range("AlignedArray::at");
+		return elements[i];
+	};
+
+	const T &at(std::size_t i) const
+	{
+		if (i >= count)
+			throw std::out_of_range("AlignedArray::at");
+		return elements[i];
+	};
+
+	T &operator[](std::size_t i) { return elements[i]; };
+	const T &operator[](std::size_t i) const { return elements[i]; };
+
+	T *data() { return elements; };
+	const T *data() const { return elements; };
+
+	T *begin() { return elements; };
+	T *end() { return elements + count; };
+	const T *begin() const { return elements; };
+	const T *end() const { return elements + count; };
+
+	/// Returns the element count.
+	std::size_t size() const { return count; };
+private:
+	T *elements = nullptr;
+	std::size_t count = 0;
+
+	void release()
+	{
+		if (!elements)
+			return;
+
+		for (std::size_t i = 0; i < count; i++)
+			elements[i].~T();
+		::operator delete(elements, std::align_val_t(alignment));
+	};
+};
@@ -21,24 +21,57 @@ public:
 
 	/// Setup the vertex buffer.
 	void set(float *verts, int verts_count, int vert_stride);
+
+	/// Setup an index buffer, making the mesh draw indexed triangles.
+	/// Does not take ownership of the buffer.
+	/// \param indices Indices into the vertex buffer, 3 per triangle.
+	/// \param indices_count Indices count
+	void set_indices(unsigned int *indices, int indices_count);
 	
 	/// Loads the mesh to the GPU.
 	virtual void load();
 	
 	/// Adds a vertex attribute array to the GPU.
 	void add_vertex_attrib_array(int index, int size, void *offset);
+
+	/// Adds a vertex attribute array of unsigned integers to the GPU, read
+	/// by the shader as uint or uvecN without conversion.
+	void add_vertex_attrib_uint_array(int index, int size, void *offset);
 	
 	/// Sets the mesh as active.
 	void use() const;
 	
 	/// Draws using the mesh.
 	void draw() const;
+
+	/// Returns the vertices count.
+	int vertices_count() const;
+
+	/// Returns the indices count, 0 if the mesh isn't indexed.
+	int indices_count() const;
+
+	/// Returns the vertex buffer, `vertex_stride` floats or 32-bit words
+	/// per vertex.
+	const float *vertex_data() const;
+
+	/// Returns the floats or words per vertex.
+	int vertex_stride() const;
+
+	/// Returns the index buffer, nullptr if the mesh isn't indexed.
+	const unsigned int *index_data() const;
+
+	/// Returns the bytes per index uploaded by `load`: 2 if every vertex
+	/// can be addressed with 16 bits, 4 otherwise.
+	int index_size() const;
 protected:
 	float *verts;
 	int verts_count;
 	int vert_stride;
+	unsigned int *indices = nullptr;
+	int idx_count = 0;
 private:
 	unsigned int vao = UINT_MAX; ///< Internal vertex array object identifier.
 	unsigned int vbo = UINT_MAX; ///< Internal vertex buffer object identifier.
+	unsigned int ebo = UINT_MAX; ///< Internal element buffer object identifier.
 };
 };
\ No newline at end of file
@@ -16,6 +16,10 @@ public:
 	glm::vec3 rotation_axis;
 	float rotation_angle_rad;
 	glm::vec3 scale;
+
+	/// Shader used in place of the depth map pass's one, for meshes in
+	/// another vertex format. Null to use the pass's shader.
+	Shader *depth_shader = nullptr;
 	
 	Model(
 		GFX::Mesh *mesh,
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cmath>
+#include <aligned_array.h>
+
+namespace Noise
+{
+	/// Tileable octaved Perlin noise evaluated once into a size^3 table,
+	/// sampled with trilinear interpolation instead of evaluating the
+	/// noise. Meant for effects and secondary detail where a table lookup
+	/// is close enough. The values can be uploaded as a repeating 3D
+	/// texture with Texture3D(data(), size(), size(), size(), filter).
+	class BakedNoise
+	{
+	public:
+		/// Bakes a table from Perlin noise repeating every `period`
+		/// lattice cells. Throws std::invalid_argument if the size isn't
+		/// a power of two or the period is outside [1, 256].
+		/// \param size Texels per side, a power of two.
+		/// \param period Lattice cells the table spans per side.
+		/// \param octaves Octaves count with increasing frequency.
+		/// \param persistence Influence multiplier of each consecutive
+		/// octave on the end result.
+		/// \param seed Seed of the Perlin permutation table.
+		/// \param threads Worker threads to split the Z slices across. 0
+		/// uses all hardware threads.
+		BakedNoise(
+			int size, int period, int octaves, double persistence,
+			unsigned int seed = 0, int threads = 1);
+
+		/// Loads the table from `path` if it holds one baked with the same
+		/// parameters, otherwise bakes it and tries to save it there.
+		static BakedNoise cached(
+			const char *path, int size, int period, int octaves,
+			double persistence, unsigned int seed = 0, int threads = 1);
+
+		/// Writes the table to `path`, in native byte order. Returns
+		/// whether it succeeded.
+		bool save(const char *path) const;
+
+		/// Returns the trilinearly interpolated noise at a point, in the
+		/// same lattice units as Perlin::octave_noise. Repeats every
+		/// `period` units along every axis.
+		float sample(float x, float y, float z) const
+		{
+			float u = x * scale, v = y * scale, w = z * scale;
+			float u0 = std::floor(u), v0 = std::floor(v), w0 = std::floor(w);
+			float fu = u - u0, fv = v - v0, fw = w - w0;
+
+			int mask = dim - 1;
+			int x0 = (int)u0 & mask, x1 = (x0 + 1) & mask;
+			int y0 = (int)v0 & mask, y1 = (y0 + 1) & mask;
+			int z0 = (int)w0 & mask, z1 = (z0 + 1) & mask;
+
+			const float *s00 = &values[((size_t)z0 * dim + y0) * dim];
+			const float *s10 = &values[((size_t)z0 * dim + y1) * dim];
+			const float *s01 = &values[((size_t)z1 * dim + y0) * dim];
+			const float *s11 = &values[((size_t)z1 * dim + y1) * dim];
+
+			float a = lerp(s00[x0], s00[x1], fu);
+			float b = lerp(s10[x0], s10[x1], fu);
+			float c = lerp(s01[x0], s01[x1], fu);
+			float d = lerp(s11[x0], s11[x1], fu);
+			return lerp(lerp(a, b, fv), lerp(c, d, fv), fw);
+		};
+
+		/// Evaluates sample for `count` points.
+		/// \param x X coordinates.
+		/// \param y Y coordinates.
+		/// \param z Z coordinates.
+		/// \param out Output buffer of at least `count` values.
+		/// \param count Amount of points to evaluate.
+		void sample_batch(
+			const float *x, const float *y, const float *z, float *out,
+			int count) const;
+
+		/// Returns the texel values, size^3 and X fastest.
+		const float *data() const { return values.data(); };
+
+		int size() const { return dim; };
+		int period() const { return repeat; };
+	private:
+		int dim;
+		int repeat;
+		int octaves;
+		double persistence;
+		unsigned int seed;
+		float scale; ///< Texels per lattice cell.
+		AlignedArray<float> values;
+
+		/// Tag of the constructor that leaves the table unfilled.
+		struct Unfilled {};
+
+		/// Checks the parameters and allocates the table.
+		BakedNoise(
+			Unfilled, int size, int period, int octaves,
+			double persistence, unsigned int seed);
+
+		/// Fills the table with noise.
+		void bake(int threads);
+
+		/// Reads a table saved with the same parameters, returns whether
+		/// it succeeded.
+		bool load(const char *path);
+
+		static float lerp(float a, float b, float t)
+		{
+			return a + t * (b - a);
+		};
+	};
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <graphics/noise.h>
+#include <graphics/volume.h>
+#include <lru_cache.h>
+
+namespace Noise
+{
+	/// Climate of a column, every field in the range of [0, 1].
+	struct Climate
+	{
+		float temperature = 0.5f;
+		float humidity = 0.5f;
+		float continentalness = 0.5f;
+	};
+
+	enum class Biome
+	{
+		Ocean,
+		Beach,
+		Desert,
+		Savanna,
+		Plains,
+		Forest,
+		Taiga,
+		Tundra
+	};
+
+	/// Materials of the top voxels of a column.
+	struct BiomeMaterials
+	{
+		GFX::VoxelMaterial surface;
+		GFX::VoxelMaterial subsurface;
+	};
+
+	/// Returns the biome of a climate.
+	Biome biome_for(const Climate &climate);
+
+	/// Returns the surface materials of a biome.
+	BiomeMaterials materials_for(Biome biome);
+
+	/// Settings of a BiomeMap. Distances are in columns.
+	struct BiomeSettings
+	{
+		/// Columns per unit of temperature and humidity noise.
+		float climate_scale = 512.0f;
+
+		/// Columns per unit of continentalness noise.
+		float continent_scale = 1024.0f;
+
+		/// Octaves count of the climate noise.
+		int octaves = 4;
+
+		/// Persistence of the climate noise.
+		double persistence = 0.5;
+
+		/// Columns between climate samples. Columns in between are
+		/// interpolated.
+		int step = 8;
+
+		/// Columns per side of a cached tile, a multiple of `step`.
+		int tile_size = 64;
+
+		/// Bytes the cached tiles may take. The least recently used ones
+		/// are dropped past it.
+		size_t cache_bytes = 4 << 20;
+
+		/// Seed of the climate noise.
+		unsigned int seed = 0;
+
+		/// Solid voxels below the surface one that get the subsurface
+		/// material.
+		int soil_depth = 3;
+	};
+
+	/// Temperature, humidity and continentalness over an unbounded XZ
+	/// plane of columns, each from its own Perlin noise. The noise is
+	/// sampled every `step` columns into tiles that are cached by their
+	/// coordinates, and columns interpolate the samples around them, so
+	/// a chunk costs a few noise evaluations instead of one per column
+	/// and field. Safe to query concurrently.
+	class BiomeMap
+	{
+	public:
+		/// Throws std::invalid_argument if `step` or `tile_size` isn't
+		/// positive or `tile_size` isn't a multiple of `step`.
+		BiomeMap(const BiomeSettings &settings = BiomeSettings());
+
+		/// Returns the climate of column (x, z).
+		Climate climate_at(int x, int z) const;
+
+		/// Returns the biome of column (x, z).
+		Biome biome_at(int x, int z) const;
+
+		/// Fills the climates of a width * depth rectangle of columns.
+		/// \param x X of the first column.
+		/// \param z Z of the first column.
+		/// \param width Columns along X.
+		/// \param depth Columns along Z.
+		/// \param out Output of width * depth climates, X fastest.
+		void climate_rect(
+			int x, int z, int width, int depth, Climate *out) const;
+
+		/// Sets the material of every solid voxel of a volume from the
+		/// biome of its column. The topmost solid voxel below an empty
+		/// one gets the surface material, the `soil_depth` voxels below
+		/// it the subsurface one and the rest stone.
+		/// \param volume Volume to paint, Y up.
+		/// \param x X of the volume's first column.
+		/// \param z Z of the volume's first column.
+		void paint(GFX::DynamicVolume &volume, int x, int z) const;
+
+		/// Returns the amount of cached tiles.
+		size_t tile_count() const;
+
+		/// Drops every cached tile.
+		void clear();
+
+		const BiomeSettings &settings() const { return config; };
+	private:
+		/// Climate samples of a tile, (tile_size / step + 1) squared,
+		/// X fastest. The last row and column repeat the first ones of
+		/// the next tiles, so interpolation never leaves a tile.
+		using Tile = std::vector<Climate>;
+
+		BiomeSettings config;
+		int samples;	///< Samples per tile side.
+		Perlin temperature, humidity, continentalness;
+
+		mutable LruCache<uint64_t, Tile> tiles;
+
+		std::shared_ptr<const Tile> tile(int tx, int tz) const;
+		std::shared_ptr<const Tile> generate(int tx, int tz) const;
+		Climate interpolate(const Tile &tile, int lx, int lz) const;
+	};
+}
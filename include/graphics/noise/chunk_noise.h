@@ -0,0 +1,253 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#include <graphics/noise.h>
+#include <lru_cache.h>
+
+namespace Noise
+{
+	/// Key of a cached chunk tile: the chunk coordinate and a hash of
+	/// everything else the noise depends on.
+	struct ChunkKey
+	{
+		int x, y, z;
+		uint64_t params;
+
+		bool operator==(const ChunkKey &other) const
+		{
+			return x == other.x && y == other.y && z == other.z
+				&& params == other.params;
+		};
+	};
+
+	struct ChunkKeyHash
+	{
+		size_t operator()(const ChunkKey &key) const
+		{
+			uint64_t h = key.params;
+			for (int c : { key.x, key.y, key.z })
+				h = (h ^ (uint32_t)c) * 0x100000001b3ull;
+			return (size_t)(h ^ (h >> 32));
+		};
+	};
+
+	/// Noise values of a chunk, X fastest. Kept in double, so that
+	/// thresholding them decides every voxel like the Volume builders do.
+	using ChunkTile = std::vector<double>;
+
+	/// Cache of chunk tiles shared by any number of ChunkNoise instances,
+	/// with a budget in bytes.
+	using ChunkCache = LruCache<ChunkKey, ChunkTile, ChunkKeyHash>;
+
+	/// Settings of a ChunkNoise. Noise coordinates are world voxel
+	/// coordinates times `scale`.
+	struct ChunkNoiseSettings
+	{
+		/// Voxels per chunk side.
+		int size = 24;
+
+		/// Noise units per voxel of the density.
+		float scale = 1.0f / 6.0f;
+
+		/// Octaves count of the density.
+		int octaves = 6;
+
+		/// Persistence of the density.
+		double persistence = 0.4;
+
+		/// Noise units per voxel of the surface.
+		float surface_scale = 1.0f / 48.0f;
+
+		/// Octaves count of the surface.
+		int surface_octaves = 4;
+
+		/// Persistence of the surface.
+		double surface_persistence = 0.5;
+	};
+
+	/// Chunk sized octaved noise at world chunk coordinates, kept in a
+	/// ChunkCache so that chunks coming back into view aren't evaluated
+	/// again. Densities are size^3 noise values of a chunk, surfaces are
+	/// size^2 values over the X and Z of a column of chunks. Tiles are
+	/// keyed by the generator's type and key(), so generators with
+	/// different seeds or parameters can share a cache.
+	template <typename G = Perlin>
+	class ChunkNoise
+	{
+	public:
+		/// The generator and the cache have to outlive the instance.
+		ChunkNoise(
+			const G &gen, const ChunkNoiseSettings &settings,
+			ChunkCache &cache
+		) : gen(gen), config(settings), cache(cache),
+			period(gen.period()), density_params(hash_params(0)),
+			surface_params(hash_params(1)) {};
+
+		/// Returns the density of chunk (x, y, z). Safe to call
+		/// concurrently.
+		std::shared_ptr<const ChunkTile> density(int x, int y, int z) const
+		{
+			return cache.get(
+				{ x, y, z, density_params },
+				[&] { return generate_density(x, y, z); }, tile_bytes);
+		};
+
+		/// Returns the surface of the chunks at (x, z). Safe to call
+		/// concurrently.
+		std::shared_ptr<const ChunkTile> surface(int x, int z) const
+		{
+			return cache.get(
+				{ x, 0, z, surface_params },
+				[&] { return generate_surface(x, z); }, tile_bytes);
+		};
+
+		const ChunkNoiseSettings &settings() const { return config; };
+	private:
+		const G &gen;
+		ChunkNoiseSettings config;
+		ChunkCache &cache;
+		double period; ///< Period of the noise, 0 if it has none.
+		uint64_t density_params;
+		uint64_t surface_params;
+
+		static size_t tile_bytes(const ChunkTile &tile)
+		{
+			return sizeof(ChunkTile) + tile.size() * sizeof(double);
+		};
+
+		/// FNV-1a of the settings, the generator type and key, and the
+		/// tile kind.
+		uint64_t hash_params(int kind) const
+		{
+			uint64_t h = 0xcbf29ce484222325ull;
+			auto add = [&h](const void *data, size_t size)
+			{
+				const unsigned char *bytes = (const unsigned char *)data;
+				for (size_t i = 0; i < size; i++)
+					h = (h ^ bytes[i]) * 0x100000001b3ull;
+			};
+
+			size_t type = typeid(G).hash_code();
+			uint64_t key = gen.key();
+			add(&type, sizeof(type));
+			add(&key, sizeof(key));
+			add(&kind, sizeof(kind));
+			add(&config.size, sizeof(config.size));
+			if (kind == 0)
+			{
+				add(&config.scale, sizeof(config.scale));
+				add(&config.octaves, sizeof(config.octaves));
+				add(&config.persistence, sizeof(config.persistence));
+			}
+			else
+			{
+				add(&config.surface_scale, sizeof(config.surface_scale));
+				add(&config.surface_octaves,
+					sizeof(config.surface_octaves));
+				add(&config.surface_persistence,
+					sizeof(config.surface_persistence));
+			}
+			return h;
+		};
+
+		/// Wraps a coordinate of periodic noise, see wrap_coordinate, so
+		/// chunks at negative coordinates continue it. Noise without a
+		/// period takes coordinates as they are.
+		double wrap(double x) const
+		{
+			return (period > 0) ? wrap_coordinate(x, period) : x;
+		};
+
+		std::shared_ptr<const ChunkTile> generate_density(
+			int cx, int cy, int cz) const
+		{
+			const int size = config.size;
+			auto tile =
+				std::make_shared<ChunkTile>((size_t)size * size * size);
+			std::vector<double> xs(size), ys(size), zs(size);
+
+			for (int ix = 0; ix < size; ix++)
+				xs[ix] = wrap(((double)cx * size + ix) * config.scale);
+
+			for (int iz = 0; iz < size; iz++)
+			for (int iy = 0; iy < size; iy++)
+			{
+				std::fill(ys.begin(), ys.end(), wrap(
+					((double)cy * size + iy) * config.scale));
+				std::fill(zs.begin(), zs.end(), wrap(
+					((double)cz * size + iz) * config.scale));
+				// Rows are contiguous, evaluate straight into them
+				double *row = &(*tile)[((size_t)iz * size + iy) * size];
+				dispatch_octave_noise_batch(
+					gen, xs.data(), ys.data(), zs.data(), row, size,
+					config.octaves, config.persistence);
+			}
+			return tile;
+		};
+
+		std::shared_ptr<const ChunkTile> generate_surface(
+			int cx, int cz) const
+		{
+			const int size = config.size;
+			auto tile = std::make_shared<ChunkTile>((size_t)size * size);
+			std::vector<double> xs(size), zs(size), ys(size, 0.0);
+
+			for (int ix = 0; ix < size; ix++)
+				xs[ix] = wrap(
+					((double)cx * size + ix) * config.surface_scale);
+
+			// Surfaces are 2D noise over (x, z) at 0, like Heightfield
+			for (int iz = 0; iz < size; iz++)
+			{
+				std::fill(zs.begin(), zs.end(), wrap(
+					((double)cz * size + iz) * config.surface_scale));
+				dispatch_octave_noise_batch(
+					gen, xs.data(), zs.data(), ys.data(),
+					&(*tile)[(size_t)iz * size], size,
+					config.surface_octaves, config.surface_persistence);
+			}
+			return tile;
+		};
+	};
+
+	/// Slice source over a cached chunk density, thresholded like
+	/// VolumeSlices, for GFX::StreamedVolumeMesh or a DynamicVolume.
+	/// Holds on to the density, so it stays valid if the cache evicts
+	/// it.
+	class ChunkDensitySlices
+	{
+	public:
+		/// \param density Density of a size^3 chunk, see
+		/// ChunkNoise::density.
+		/// \param size Voxels per chunk side.
+		/// \param threshold Densities above it are solid.
+		ChunkDensitySlices(
+			std::shared_ptr<const ChunkTile> density, int size,
+			double threshold = 0.5
+		) : density(std::move(density)), size(size),
+			threshold(threshold) {};
+
+		/// Writes Z slice `z`. Safe to call concurrently.
+		/// \param out Output of size^2 bytes, X fastest, 1 for solid
+		/// voxels and 0 for empty ones.
+		void slice(int z, unsigned char *out) const
+		{
+			const size_t count = (size_t)size * size;
+			const double *values = density->data() + z * count;
+			for (size_t i = 0; i < count; i++)
+				out[i] = values[i] > threshold;
+		};
+
+		int x_size() const { return size; };
+		int y_size() const { return size; };
+		int z_size() const { return size; };
+	private:
+		std::shared_ptr<const ChunkTile> density;
+		int size;
+		double threshold;
+	};
+}
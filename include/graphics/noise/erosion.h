@@ -0,0 +1,87 @@
+#pragma once
+
+#include <graphics/image.h>
+
+namespace Noise
+{
+	/// Settings of the grid hydraulic erosion, see erode. Heights and
+	/// water are measured in cells.
+	struct Erosion
+	{
+		/// Simulation steps. Each step moves water and sediment by up to
+		/// a cell.
+		int iterations = 128;
+
+		/// Length of a step.
+		float dt = 0.1f;
+
+		/// Height of the full [0, 1] image range relative to the image
+		/// width, used when eroding an Image.
+		float relief = 0.1f;
+
+		/// Water added to every cell per unit of time.
+		float rain = 0.05f;
+
+		/// Fraction of water evaporating per unit of time.
+		float evaporation = 0.05f;
+
+		/// Acceleration of water down a height difference. Steps stay
+		/// stable while dt * dt * gravity is below about 0.125.
+		float gravity = 9.81f;
+
+		/// Fraction of the water flow lost per unit of time. Damps the
+		/// waves pools would otherwise carry forever.
+		float friction = 2.0f;
+
+		/// Sediment carried per unit of water speed and slope.
+		float capacity = 1.0f;
+
+		/// Water depth below which the speed is computed as if the
+		/// water was this deep.
+		float shallow_depth = 0.1f;
+
+		/// Lowest slope used for the capacity, so that water on flat
+		/// ground still carries some sediment.
+		float min_slope = 0.05f;
+
+		/// Fraction of the missing capacity dissolved per step.
+		float dissolving = 0.5f;
+
+		/// Fraction of the excess sediment deposited per step.
+		float deposition = 0.5f;
+
+		/// Height difference between neighbouring cells above which
+		/// ground slides down.
+		float talus = 0.8f;
+
+		/// Fraction of the height above the talus slope that slides per
+		/// step. At most 0.125 to stay stable.
+		float sliding = 0.1f;
+	};
+
+	/// Runs hydraulic erosion over a heightfield with the virtual pipe
+	/// model: water flows between neighbouring cells through pipes,
+	/// dissolves ground where it moves faster than the sediment it carries
+	/// allows, and deposits it where it slows down. Every step is a few
+	/// passes over the grid which only read the neighbours of a cell, so
+	/// rows are split across threads and the output doesn't depend on
+	/// the thread count.
+	/// \param heights Width * height heights in cells, X fastest.
+	/// \param width Width of the heightfield.
+	/// \param height Height of the heightfield.
+	/// \param settings Erosion settings.
+	/// \param threads Worker threads to split the rows across. 0 uses all
+	/// hardware threads.
+	void erode(
+		float *heights, int width, int height, const Erosion &settings,
+		int threads = 1);
+
+	/// Erodes a grayscale heightmap image in place, e.g. a Noise::Image.
+	/// Heights are read from the first channel and written to all color
+	/// channels, leaving alpha as is.
+	/// \param image Image to erode.
+	/// \param settings Erosion settings.
+	/// \param threads Worker threads to split the rows across. 0 uses all
+	/// hardware threads.
+	void erode(::Image &image, const Erosion &settings, int threads = 1);
+}
@@ -0,0 +1,452 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <graphics/noise.h>
+
+// Composable noise recipes. Each node is a small value type whose children
+// are template parameters, so a whole recipe such as
+//
+//     auto terrain = Graph::select(
+//         Graph::fbm(Graph::source(perlin), 4, 0.5),
+//         Graph::ridged(Graph::source(perlin), 6, 0.45),
+//         Graph::warp(
+//             Graph::fbm(Graph::source(simplex), 3, 0.5),
+//             Graph::fbm(Graph::source(perlin), 2, 0.5), 0.25),
+//         0.55, 0.05);
+//
+// is a single type. Evaluating it calls the generators' non-virtual sample
+// functions directly and everything in between inlines into one per-sample
+// function.
+//
+// Every node is callable as node(x, y, z) for float or double coordinates
+// and, like the generators, outputs values in about [0, 1].
+//
+// Perlin noise goes wrong for negative coordinates, so sources of
+// periodic generators wrap them into the period first, see Source.
+// Recipes over Perlin noise therefore repeat every 256 units, or every
+// `repeat` units, like the noise itself. Sources of generators without a
+// period take coordinates as they are.
+
+namespace Noise
+{
+namespace Graph
+{
+	/// Samples a generator. G needs a non-virtual `sample(x, y, z)` and
+	/// `period()`, as BasicPerlin and BasicSimplex have. Negative
+	/// coordinates of periodic generators are wrapped into the period,
+	/// see wrap_coordinate. Non-negative ones already repeat within the
+	/// generator and are passed as they are, so fBm over a source
+	/// matches the generator's octave_noise for them.
+	template <typename G>
+	struct Source
+	{
+		const G *gen;
+
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			const double period = gen->period();
+			if (period > 0)
+			{
+				x = wrap(x, period);
+				y = wrap(y, period);
+				z = wrap(z, period);
+			}
+			return (T)gen->sample(x, y, z);
+		}
+
+		/// The wrapped value is exact, so it fits T too.
+		template <typename T>
+		static T wrap(T v, double period)
+		{
+			return (v < 0) ? (T)wrap_coordinate(v, period) : v;
+		}
+	};
+
+	/// Outputs a constant value.
+	struct Constant
+	{
+		double value;
+
+		template <typename T>
+		T operator()(T, T, T) const
+		{
+			return (T)value;
+		}
+	};
+
+	/// Fractal Brownian motion, octaves of the input with doubling
+	/// frequency and `persistence` scaled amplitude. Matches octave_noise
+	/// of a generator when the input is its Source.
+	template <typename N>
+	struct FBm
+	{
+		N input;
+		int octaves;
+		double persistence;
+
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			T total = 0;
+			T frequency = 1;
+			T amplitude = 1;
+			T max_val = 0;  // Used for normalizing result to 0.0 - 1.0
+
+			for (int i = 0; i < octaves; i++)
+			{
+				total += input(
+					x * frequency, y * frequency, z * frequency)
+					* amplitude;
+
+				max_val += amplitude;
+
+				amplitude *= (T)persistence;
+				frequency *= 2;
+			}
+
+			return total / max_val;
+		}
+	};
+
+	/// Ridged multifractal. Each octave is folded into 1 - |2n - 1| and
+	/// squared, which turns the zero crossings of the input into sharp
+	/// ridges. Octaves are weighted by the previous one, so detail piles
+	/// up on the ridges and valleys stay smooth.
+	template <typename N>
+	struct Ridged
+	{
+		N input;
+		int octaves;
+		double persistence;
+
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			T total = 0;
+			T frequency = 1;
+			T amplitude = 1;
+			T max_val = 0;
+			T weight = 1;
+
+			for (int i = 0; i < octaves; i++)
+			{
+				T n = input(x * frequency, y * frequency, z * frequency);
+				T signal = 1 - std::abs(2 * n - 1);
+				signal *= signal * weight;
+				weight = std::min(std::max(signal * 2, (T)0), (T)1);
+
+				total += signal * amplitude;
+				max_val += amplitude;
+
+				amplitude *= (T)persistence;
+				frequency *= 2;
+			}
+
+			return total / max_val;
+		}
+	};
+
+	/// Billowy fBm. Each octave is folded into |2n - 1|, which gives
+	/// rounded, cloud or hill like shapes.
+	template <typename N>
+	struct Billow
+	{
+		N input;
+		int octaves;
+		double persistence;
+
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			T total = 0;
+			T frequency = 1;
+			T amplitude = 1;
+			T max_val = 0;
+
+			for (int i = 0; i < octaves; i++)
+			{
+				T n = input(x * frequency, y * frequency, z * frequency);
+				total += std::abs(2 * n - 1) * amplitude;
+				max_val += amplitude;
+
+				amplitude *= (T)persistence;
+				frequency *= 2;
+			}
+
+			return total / max_val;
+		}
+	};
+
+	/// Domain warp. Offsets the input coordinates by the warp node,
+	/// sampled at three decorrelated positions, remapped to [-1, 1] and
+	/// scaled by `strength`.
+	template <typename N, typename W>
+	struct Warp
+	{
+		N input;
+		W warp;
+		double strength;
+
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			// Arbitrary offsets so the three axes don't move together
+			T dx = warp(x, y, z);
+			T dy = warp(x + (T)31.7, y + (T)17.3, z + (T)5.1);
+			T dz = warp(x + (T)11.9, y + (T)43.3, z + (T)23.7);
+
+			T s = (T)strength;
+			return input(
+				x + s * (2 * dx - 1),
+				y + s * (2 * dy - 1),
+				z + s * (2 * dz - 1));
+		}
+	};
+
+	/// Sum of two nodes.
+	template <typename A, typename B>
+	struct Add
+	{
+		A a;
+		B b;
+
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			return a(x, y, z) + b(x, y, z);
+		}
+	};
+
+	/// Product of two nodes.
+	template <typename A, typename B>
+	struct Mul
+	{
+		A a;
+		B b;
+
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			return a(x, y, z) * b(x, y, z);
+		}
+	};
+
+	/// Clamps a node to [low, high].
+	template <typename N>
+	struct Clamp
+	{
+		N input;
+		double low;
+		double high;
+
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			return std::min(
+				std::max(input(x, y, z), (T)low), (T)high);
+		}
+	};
+
+	/// Outputs `a` where the control node is above `threshold` and `b`
+	/// below it, blending them with a smoothstep within `falloff` of the
+	/// threshold. Only the selected node is evaluated outside of the
+	/// blend band.
+	template <typename C, typename A, typename B>
+	struct Select
+	{
+		C control;
+		A a;
+		B b;
+		double threshold;
+		double falloff;
+
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			T c = control(x, y, z);
+			T low = (T)(threshold - falloff);
+			T high = (T)(threshold + falloff);
+
+			if (c <= low)
+				return b(x, y, z);
+			if (c >= high)
+				return a(x, y, z);
+
+			T t = (c - low) / (high - low);
+			t = t * t * (3 - 2 * t);
+			T vb = b(x, y, z);
+			return vb + t * (a(x, y, z) - vb);
+		}
+	};
+
+	/// Outputs 1 where the input is above `threshold` and 0 elsewhere.
+	template <typename N>
+	struct Threshold
+	{
+		N input;
+		double threshold;
+
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			return (input(x, y, z) > (T)threshold) ? (T)1 : (T)0;
+		}
+	};
+
+	// Node constructors, so that recipes don't have to spell out types.
+
+	template <typename G>
+	Source<G> source(const G &gen)
+	{
+		return { &gen };
+	}
+
+	inline Constant constant(double value)
+	{
+		return { value };
+	}
+
+	template <typename N>
+	FBm<N> fbm(N input, int octaves, double persistence)
+	{
+		return { input, octaves, persistence };
+	}
+
+	template <typename N>
+	Ridged<N> ridged(N input, int octaves, double persistence)
+	{
+		return { input, octaves, persistence };
+	}
+
+	template <typename N>
+	Billow<N> billow(N input, int octaves, double persistence)
+	{
+		return { input, octaves, persistence };
+	}
+
+	template <typename N, typename W>
+	Warp<N, W> warp(N input, W warp, double strength)
+	{
+		return { input, warp, strength };
+	}
+
+	template <typename A, typename B>
+	Add<A, B> add(A a, B b)
+	{
+		return { a, b };
+	}
+
+	template <typename A, typename B>
+	Mul<A, B> mul(A a, B b)
+	{
+		return { a, b };
+	}
+
+	template <typename N>
+	Clamp<N> clamp(N input, double low = 0.0, double high = 1.0)
+	{
+		return { input, low, high };
+	}
+
+	template <typename C, typename A, typename B>
+	Select<C, A, B> select(
+		C control, A a, B b, double threshold, double falloff = 0.0)
+	{
+		return { control, a, b, threshold, falloff };
+	}
+
+	template <typename N>
+	Threshold<N> threshold(N input, double threshold)
+	{
+		return { input, threshold };
+	}
+
+	/// Wraps a recipe in the virtual generator interfaces, so that it can
+	/// be handed to Noise::Image and Noise::Volume. octave_noise runs fBm
+	/// over the recipe. The batch functions evaluate the recipe inline,
+	/// with one virtual call per batch rather than per sample, or none
+	/// when passed as a concrete type, see Noise::is_concrete_generator.
+	template <typename N>
+	class Recipe : public Noise::Generator, public Noise::OctavedGenerator
+	{
+	public:
+		/// Creates a generator from a recipe.
+		/// \param node Root node of the recipe.
+		Recipe(N node) : node(node) {};
+
+		virtual double noise(double x, double y, double z) const
+		{
+			return node(x, y, z);
+		};
+
+		virtual double octave_noise(
+			double x, double y, double z, int octaves,
+			double persistence) const
+		{
+			return octaved(octaves, persistence)(x, y, z);
+		};
+
+		virtual void octave_noise_batch(
+			const double *x, const double *y, const double *z,
+			double *out, int count, int octaves,
+			double persistence) const
+		{
+			FBm<N> fbm = octaved(octaves, persistence);
+			for (int i = 0; i < count; i++)
+				out[i] = fbm(x[i], y[i], z[i]);
+		};
+
+		virtual void octave_noise_batch(
+			const float *x, const float *y, const float *z,
+			float *out, int count, int octaves,
+			float persistence) const
+		{
+			FBm<N> fbm = octaved(octaves, persistence);
+			for (int i = 0; i < count; i++)
+				out[i] = fbm(x[i], y[i], z[i]);
+		};
+
+		virtual void octave_threshold_batch(
+			const double *x, const double *y, const double *z,
+			unsigned char *out, int count, int octaves,
+			double persistence, double threshold) const
+		{
+			FBm<N> fbm = octaved(octaves, persistence);
+			for (int i = 0; i < count; i++)
+				out[i] = (fbm(x[i], y[i], z[i]) > threshold) ? 1 : 0;
+		};
+		
+		virtual void octave_threshold_batch(
+			const float *x, const float *y, const float *z,
+			unsigned char *out, int count, int octaves,
+			float persistence, double threshold) const
+		{
+			FBm<N> fbm = octaved(octaves, persistence);
+			for (int i = 0; i < count; i++)
+				out[i] = (fbm(x[i], y[i], z[i]) > threshold) ? 1 : 0;
+		};
+		
+		/// Evaluates the recipe.
+		template <typename T>
+		T operator()(T x, T y, T z) const
+		{
+			return node(x, y, z);
+		}
+	private:
+		N node;
+
+		FBm<N> octaved(int octaves, double persistence) const
+		{
+			return { node, octaves, persistence };
+		}
+	};
+
+	template <typename N>
+	Recipe<N> recipe(N node)
+	{
+		return Recipe<N>(node);
+	}
+}
+}
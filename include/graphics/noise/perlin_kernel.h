@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+
+// Vector Perlin noise kernels, written once against a small traits
+// interface and instantiated per instruction set in their own translation
+// units (see src/graphics/noise/perlin_*.cpp). The kernels mirror
+// Noise::Perlin::noise and Noise::Perlin::octave_noise operation for
+// operation, so every lane rounds exactly like the scalar path does.
+//
+// A traits type `S` provides:
+//   Real, V (Real vector), I (int32 vector), M (lane mask), width
+//   load, store, set1, add, sub, mul, div, neg, trunc, select, gt, bits
+//   to_int, iset1, iadd, iand, ior, icmpeq, icmplt, lookup, mask
+
+namespace Noise
+{
+namespace Kernel
+{
+	/// Eases coordinate values towards integral values.
+	/// 6t^5 - 15t^4 + 10t^3
+	template <typename S>
+	inline typename S::V perlin_fade(typename S::V t)
+	{
+		using Real = typename S::Real;
+		typename S::V t3 = S::mul(S::mul(t, t), t);
+		typename S::V p = S::sub(
+			S::mul(t, S::set1((Real)6)), S::set1((Real)15));
+		p = S::add(S::mul(t, p), S::set1((Real)10));
+		return S::mul(t3, p);
+	}
+
+	template <typename S>
+	inline typename S::V perlin_lerp(
+		typename S::V a, typename S::V b, typename S::V x)
+	{
+		return S::add(a, S::mul(x, S::sub(b, a)));
+	}
+
+	/// Selects one of the 16 gradient directions by hash without
+	/// branching. Produces the same values as the switch in
+	/// Noise::Perlin::grad.
+	template <typename S>
+	inline typename S::V perlin_grad(
+		typename S::I hash, typename S::V x, typename S::V y,
+		typename S::V z)
+	{
+		typename S::I h = S::iand(hash, S::iset1(0xF));
+
+		typename S::V u = S::select(
+			S::mask(S::icmplt(h, S::iset1(8))), x, y);
+		typename S::I h_x = S::ior(
+			S::icmpeq(h, S::iset1(0xC)), S::icmpeq(h, S::iset1(0xE)));
+		typename S::V v = S::select(
+			S::mask(S::icmplt(h, S::iset1(4))),
+			y,
+			S::select(S::mask(h_x), x, z));
+
+		typename S::I one = S::iset1(1);
+		typename S::I two = S::iset1(2);
+		u = S::select(
+			S::mask(S::icmpeq(S::iand(h, one), one)), S::neg(u), u);
+		v = S::select(
+			S::mask(S::icmpeq(S::iand(h, two), two)), S::neg(v), v);
+		return S::add(u, v);
+	}
+
+	/// Vector counterpart of Noise::Perlin::noise without `repeat`.
+	template <typename S>
+	inline typename S::V perlin_noise(
+		const int *perms, typename S::V x, typename S::V y,
+		typename S::V z)
+	{
+		using V = typename S::V;
+		using I = typename S::I;
+		using Real = typename S::Real;
+
+		I mask = S::iset1(255);
+		I xi = S::iand(S::to_int(x), mask);
+		I yi = S::iand(S::to_int(y), mask);
+		I zi = S::iand(S::to_int(z), mask);
+
+		V xf = S::sub(x, S::trunc(x));
+		V yf = S::sub(y, S::trunc(y));
+		V zf = S::sub(z, S::trunc(z));
+
+		V u = perlin_fade<S>(xf);
+		V v = perlin_fade<S>(yf);
+		V w = perlin_fade<S>(zf);
+
+		I one = S::iset1(1);
+		I xi1 = S::iadd(xi, one);
+		I yi1 = S::iadd(yi, one);
+		I zi1 = S::iadd(zi, one);
+
+		I a  = S::lookup(perms, xi);
+		I b  = S::lookup(perms, xi1);
+		I aa = S::lookup(perms, S::iadd(a, yi));
+		I ab = S::lookup(perms, S::iadd(a, yi1));
+		I ba = S::lookup(perms, S::iadd(b, yi));
+		I bb = S::lookup(perms, S::iadd(b, yi1));
+
+		I aaa = S::lookup(perms, S::iadd(aa, zi));
+		I aba = S::lookup(perms, S::iadd(ab, zi));
+		I aab = S::lookup(perms, S::iadd(aa, zi1));
+		I abb = S::lookup(perms, S::iadd(ab, zi1));
+		I baa = S::lookup(perms, S::iadd(ba, zi));
+		I bba = S::lookup(perms, S::iadd(bb, zi));
+		I bab = S::lookup(perms, S::iadd(ba, zi1));
+		I bbb = S::lookup(perms, S::iadd(bb, zi1));
+
+		V one_r = S::set1((Real)1);
+		V xf1 = S::sub(xf, one_r);
+		V yf1 = S::sub(yf, one_r);
+		V zf1 = S::sub(zf, one_r);
+
+		V x1, x2, y1, y2;
+		x1 = perlin_lerp<S>(
+			perlin_grad<S>(aaa, xf, yf, zf),
+			perlin_grad<S>(baa, xf1, yf, zf),
+			u);
+		x2 = perlin_lerp<S>(
+			perlin_grad<S>(aba, xf, yf1, zf),
+			perlin_grad<S>(bba, xf1, yf1, zf),
+			u);
+		y1 = perlin_lerp<S>(x1, x2, v);
+
+		x1 = perlin_lerp<S>(
+			perlin_grad<S>(aab, xf, yf, zf1),
+			perlin_grad<S>(bab, xf1, yf, zf1),
+			u);
+		x2 = perlin_lerp<S>(
+			perlin_grad<S>(abb, xf, yf1, zf1),
+			perlin_grad<S>(bbb, xf1, yf1, zf1),
+			u);
+		y2 = perlin_lerp<S>(x1, x2, v);
+
+		return S::div(
+			S::add(perlin_lerp<S>(y1, y2, w), one_r),
+			S::set1((Real)2));
+	}
+
+	/// Vector counterpart of Noise::Perlin::octave_noise without `repeat`.
+	/// \return Amount of points processed, `count` rounded down to a
+	/// multiple of the vector width.
+	template <typename S>
+	int perlin_octave_noise(
+		const int *perms, const typename S::Real *x,
+		const typename S::Real *y, const typename S::Real *z,
+		typename S::Real *out, int count, int octaves,
+		typename S::Real persistence)
+	{
+		using V = typename S::V;
+		using Real = typename S::Real;
+
+		int vec_count = count - count % S::width;
+		for (int i = 0; i < vec_count; i += S::width)
+		{
+			V px = S::load(x + i);
+			V py = S::load(y + i);
+			V pz = S::load(z + i);
+
+			V total = S::set1((Real)0);
+			Real frequency = 1;
+			Real amplitude = 1;
+			Real max_val = 0;
+
+			for (int o = 0; o < octaves; o++)
+			{
+				V f = S::set1(frequency);
+				V n = perlin_noise<S>(
+					perms, S::mul(px, f), S::mul(py, f),
+					S::mul(pz, f));
+				total = S::add(total, S::mul(n, S::set1(amplitude)));
+
+				max_val += amplitude;
+
+				amplitude *= persistence;
+				frequency *= 2;
+			}
+
+			S::store(out + i, S::div(total, S::set1(max_val)));
+		}
+		return vec_count;
+	}
+	
+	/// Vector counterpart of Noise::octave_above over Perlin noise without
+	/// `repeat`. Each lane is decided as soon as the bounds allow, and a
+	/// vector stops evaluating octaves once all of its lanes are decided.
+	/// Lanes left undecided compare the full octave_sample value, rounded
+	/// to float first if `round_to_float` is set.
+	/// \return Amount of points processed, `count` rounded down to a
+	/// multiple of the vector width.
+	template <typename S>
+	int perlin_octave_threshold(
+		const int *perms, const typename S::Real *x,
+		const typename S::Real *y, const typename S::Real *z,
+		unsigned char *out, int count, int octaves,
+		typename S::Real persistence, double threshold,
+		typename S::Real low, typename S::Real high, double margin,
+		bool round_to_float = false)
+	{
+		using V = typename S::V;
+		using Real = typename S::Real;
+		
+		const int all = (1 << S::width) - 1;
+		
+		Real amplitude_sum = 0;
+		Real a = 1;
+		for (int o = 0; o < octaves; o++)
+		{
+			amplitude_sum += a;
+			a *= persistence;
+		}
+		
+		V zero = S::set1((Real)0);
+		V above_limit = S::set1((Real)(threshold + margin));
+		V below_limit = S::set1((Real)(threshold - margin));
+		
+		int vec_count = count - count % S::width;
+		for (int i = 0; i < vec_count; i += S::width)
+		{
+			V px = S::load(x + i);
+			V py = S::load(y + i);
+			V pz = S::load(z + i);
+			
+			// The bounds need non-negative coordinates and amplitudes
+			int unbounded = (persistence < 0)
+				? all
+				: S::bits(S::gt(zero, px)) | S::bits(S::gt(zero, py))
+					| S::bits(S::gt(zero, pz));
+			int above = 0;
+			int below = 0;
+			
+			V total = zero;
+			Real frequency = 1;
+			Real amplitude = 1;
+			Real max_val = 0;
+			
+			for (int o = 0; o < octaves; o++)
+			{
+				V f = S::set1(frequency);
+				V n = perlin_noise<S>(
+					perms, S::mul(px, f), S::mul(py, f),
+					S::mul(pz, f));
+				total = S::add(total, S::mul(n, S::set1(amplitude)));
+				
+				max_val += amplitude;
+				
+				amplitude *= persistence;
+				frequency *= 2;
+				
+				if (o + 1 < octaves)
+				{
+					Real rest = std::max(amplitude_sum - max_val, (Real)0);
+					V sum = S::set1(amplitude_sum);
+					V lowest = S::div(
+						S::add(total, S::set1(low * rest)), sum);
+					V highest = S::div(
+						S::add(total, S::set1(high * rest)), sum);
+					above |= S::bits(S::gt(lowest, above_limit))
+						& ~unbounded;
+					below |= S::bits(S::gt(below_limit, highest))
+						& ~unbounded;
+					if ((above | below) == all)
+						break;
+				}
+			}
+			
+			Real noise[S::width];
+			S::store(noise, S::div(total, S::set1(max_val)));
+			for (int l = 0; l < S::width; l++)
+			{
+				if ((above >> l) & 1)
+					out[i + l] = 1;
+				else if ((below >> l) & 1)
+					out[i + l] = 0;
+				else
+				{
+					double value = round_to_float
+						? (double)(float)noise[l] : (double)noise[l];
+					out[i + l] = (value > threshold) ? 1 : 0;
+				}
+			}
+		}
+		return vec_count;
+	}
+}
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Noise
+{
+	/// Instruction set used by the batched noise kernels.
+	enum class SimdLevel
+	{
+		Scalar,	///< Portable scalar fallback.
+		SSE41,	///< SSE4.1, 2 doubles or 4 floats per vector.
+		AVX2	///< AVX2, 4 doubles or 8 floats per vector.
+	};
+
+	/// Returns the instruction set the batched kernels currently dispatch
+	/// to. Detected from the running CPU on first use.
+	SimdLevel simd_level();
+
+	/// Returns the best instruction set supported by the running CPU.
+	SimdLevel supported_simd_level();
+
+	/// Overrides the instruction set used by the batched kernels, e.g. to
+	/// compare against the scalar path. Levels above the one supported by
+	/// the running CPU are clamped down to it.
+	void set_simd_level(SimdLevel level);
+
+	/// Returns a printable name of a SimdLevel.
+	const char *to_string(SimdLevel level);
+
+	namespace Kernel
+	{
+		/// Evaluates octaved Perlin noise for `count` points using the
+		/// active instruction set.
+		/// \param perms 512 entry permutation table.
+		/// \return Amount of leading points processed. The remaining
+		/// tail, shorter than a vector, is left to the caller.
+		int perlin_octave_noise(
+			const int *perms, const double *x, const double *y,
+			const double *z, double *out, int count, int octaves,
+			double persistence);
+
+		int perlin_octave_noise_sse41(
+			const int *perms, const double *x, const double *y,
+			const double *z, double *out, int count, int octaves,
+			double persistence);
+
+		int perlin_octave_noise_avx2(
+			const int *perms, const double *x, const double *y,
+			const double *z, double *out, int count, int octaves,
+			double persistence);
+		
+		/// Single precision variant of perlin_octave_noise.
+		int perlin_octave_noise(
+			const int *perms, const float *x, const float *y,
+			const float *z, float *out, int count, int octaves,
+			float persistence);
+		
+		int perlin_octave_noise_sse41(
+			const int *perms, const float *x, const float *y,
+			const float *z, float *out, int count, int octaves,
+			float persistence);
+		
+		int perlin_octave_noise_avx2(
+			const int *perms, const float *x, const float *y,
+			const float *z, float *out, int count, int octaves,
+			float persistence);
+		
+		/// Decides for `count` points whether octaved Perlin noise is
+		/// above `threshold` using the active instruction set, see
+		/// Noise::octave_above. A vector stops evaluating octaves once
+		/// all of its lanes are decided.
+		/// \param perms 512 entry permutation table.
+		/// \param out Output of 1 or 0 per point.
+		/// \param low Lower bound of a single octave.
+		/// \param high Upper bound of a single octave.
+		/// \param margin Rounding margin kept around `threshold`.
+		/// \param round_to_float Compare the value of undecided points
+		/// rounded to float, as thresholding a float batch of the same
+		/// noise would.
+		/// \return Amount of leading points processed. The remaining
+		/// tail, shorter than a vector, is left to the caller.
+		int perlin_octave_threshold(
+			const int *perms, const double *x, const double *y,
+			const double *z, unsigned char *out, int count, int octaves,
+			double persistence, double threshold, double low, double high,
+			double margin, bool round_to_float);
+		
+		int perlin_octave_threshold_sse41(
+			const int *perms, const double *x, const double *y,
+			const double *z, unsigned char *out, int count, int octaves,
+			double persistence, double threshold, double low, double high,
+			double margin, bool round_to_float);
+		
+		int perlin_octave_threshold_avx2(
+			const int *perms, const double *x, const double *y,
+			const double *z, unsigned char *out, int count, int octaves,
+			double persistence, double threshold, double low, double high,
+			double margin, bool round_to_float);
+		
+		/// Single precision variant of perlin_octave_threshold.
+		int perlin_octave_threshold(
+			const int *perms, const float *x, const float *y,
+			const float *z, unsigned char *out, int count, int octaves,
+			float persistence, double threshold, float low, float high,
+			double margin);
+		
+		int perlin_octave_threshold_sse41(
+			const int *perms, const float *x, const float *y,
+			const float *z, unsigned char *out, int count, int octaves,
+			float persistence, double threshold, float low, float high,
+			double margin);
+		
+		int perlin_octave_threshold_avx2(
+			const int *perms, const float *x, const float *y,
+			const float *z, unsigned char *out, int count, int octaves,
+			float persistence, double threshold, float low, float high,
+			double margin);
+		
+		/// Measures the squared distances from `count` points to the
+		/// nearest and second nearest of 27 Worley feature points using
+		/// the active instruction set. Points and feature points are
+		/// relative to the corner of the cell all the points lie in.
+		/// \param fx Feature point X coordinates, 27 values.
+		/// \param fy Feature point Y coordinates, 27 values.
+		/// \param fz Feature point Z coordinates, 27 values.
+		/// \param f1 Output of the squared nearest distances.
+		/// \param f2 Output of the squared second nearest distances.
+		/// \return Amount of leading points processed. The remaining
+		/// tail, shorter than a vector, is left to the caller.
+		int worley_nearest(
+			const double *fx, const double *fy, const double *fz,
+			const double *x, const double *y, const double *z,
+			double *f1, double *f2, int count);
+		
+		int worley_nearest_sse41(
+			const double *fx, const double *fy, const double *fz,
+			const double *x, const double *y, const double *z,
+			double *f1, double *f2, int count);
+		
+		int worley_nearest_avx2(
+			const double *fx, const double *fy, const double *fz,
+			const double *x, const double *y, const double *z,
+			double *f1, double *f2, int count);
+		
+		/// Single precision variant of worley_nearest.
+		int worley_nearest(
+			const float *fx, const float *fy, const float *fz,
+			const float *x, const float *y, const float *z,
+			float *f1, float *f2, int count);
+		
+		int worley_nearest_sse41(
+			const float *fx, const float *fy, const float *fz,
+			const float *x, const float *y, const float *z,
+			float *f1, float *f2, int count);
+		
+		int worley_nearest_avx2(
+			const float *fx, const float *fy, const float *fz,
+			const float *x, const float *y, const float *z,
+			float *f1, float *f2, int count);
+		
+		/// Measures the squared distances from `count` points to the
+		/// nearest and second nearest Worley feature points of the 27
+		/// cells around each of them using the active instruction set.
+		/// Each point hashes its own cells, so they may lie anywhere.
+		/// Only vectors of at least 4 lanes beat the scalar path.
+		/// \param seed Hashed seed of the generator.
+		/// \param f1 Output of the squared nearest distances.
+		/// \param f2 Output of the squared second nearest distances.
+		/// \return Amount of leading points processed. The remaining
+		/// tail, shorter than a vector, is left to the caller.
+		int worley_nearest_cells(
+			uint32_t seed, const double *x, const double *y,
+			const double *z, double *f1, double *f2, int count);
+		
+		int worley_nearest_cells_avx2(
+			uint32_t seed, const double *x, const double *y,
+			const double *z, double *f1, double *f2, int count);
+		
+		/// Single precision variant of worley_nearest_cells.
+		int worley_nearest_cells(
+			uint32_t seed, const float *x, const float *y,
+			const float *z, float *f1, float *f2, int count);
+		
+		int worley_nearest_cells_sse41(
+			uint32_t seed, const float *x, const float *y,
+			const float *z, float *f1, float *f2, int count);
+		
+		int worley_nearest_cells_avx2(
+			uint32_t seed, const float *x, const float *y,
+			const float *z, float *f1, float *f2, int count);
+	}
+}
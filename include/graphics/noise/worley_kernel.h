@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+// Vector Worley noise kernels, written once against a small traits
+// interface and instantiated per instruction set in their own translation
+// units (see src/graphics/noise/worley_*.cpp). The kernels mirror
+// Noise::BasicWorley::nearest operation for operation, so every lane
+// rounds exactly like the scalar path does.
+//
+// A traits type `S` provides:
+//   Real, V (Real vector), I (int32 vector), width
+//   load, store, set1, add, sub, mul, min, max, floor, to_int, to_real
+//   iset1, iadd, iand, ixor, imul, isrl<n>
+
+namespace Noise
+{
+namespace Kernel
+{
+	/// Squared distances from `count` points to the nearest and second
+	/// nearest of 27 feature points, one point per lane. The points all
+	/// lie in the same cell, so every lane scans the same feature points
+	/// and no lane needs a horizontal reduction.
+	/// \return Amount of points processed, `count` rounded down to a
+	/// multiple of the vector width.
+	template <typename S>
+	int worley_nearest(
+		const typename S::Real *fx, const typename S::Real *fy,
+		const typename S::Real *fz, const typename S::Real *x,
+		const typename S::Real *y, const typename S::Real *z,
+		typename S::Real *f1, typename S::Real *f2, int count)
+	{
+		using Real = typename S::Real;
+		using V = typename S::V;
+
+		int n = count - count % S::width;
+		for (int i = 0; i < n; i += S::width)
+		{
+			V px = S::load(x + i);
+			V py = S::load(y + i);
+			V pz = S::load(z + i);
+			V d1 = S::set1(std::numeric_limits<Real>::max());
+			V d2 = d1;
+			for (int j = 0; j < 27; j++)
+			{
+				V dx = S::sub(S::set1(fx[j]), px);
+				V dy = S::sub(S::set1(fy[j]), py);
+				V dz = S::sub(S::set1(fz[j]), pz);
+				V d = S::add(
+					S::add(S::mul(dx, dx), S::mul(dy, dy)),
+					S::mul(dz, dz));
+				d2 = S::min(d2, S::max(d1, d));
+				d1 = S::min(d1, d);
+			}
+			S::store(f1 + i, d1);
+			S::store(f2 + i, d2);
+		}
+		return n;
+	}
+
+	/// Mixes two words into a well distributed hash. Produces the same
+	/// values as Noise::BasicWorley::hash.
+	template <typename S>
+	inline typename S::I worley_hash(typename S::I a, typename S::I b)
+	{
+		typename S::I h = S::ixor(
+			a, S::imul(b, S::iset1((int)0x9e3779b9u)));
+		h = S::ixor(h, S::template isrl<16>(h));
+		h = S::imul(h, S::iset1((int)0x7feb352du));
+		h = S::ixor(h, S::template isrl<15>(h));
+		h = S::imul(h, S::iset1((int)0x846ca68bu));
+		h = S::ixor(h, S::template isrl<16>(h));
+		return h;
+	}
+
+	/// Squared distances from `count` points to the nearest and second
+	/// nearest feature points of the 27 cells around each of them, one
+	/// point per lane. Unlike worley_nearest, every lane hashes the
+	/// feature points of its own cell, so the points may lie anywhere.
+	/// Mirrors Noise::BasicWorley::neighbourhood and place.
+	/// \return Amount of points processed, `count` rounded down to a
+	/// multiple of the vector width.
+	template <typename S>
+	int worley_nearest_cells(
+		uint32_t seed, const typename S::Real *x,
+		const typename S::Real *y, const typename S::Real *z,
+		typename S::Real *f1, typename S::Real *f2, int count)
+	{
+		using Real = typename S::Real;
+		using V = typename S::V;
+		using I = typename S::I;
+
+		const V scale = S::set1((Real)1 / 1024);
+		const I bits = S::iset1(0x3FF);
+
+		int n = count - count % S::width;
+		for (int i = 0; i < n; i += S::width)
+		{
+			V px = S::load(x + i);
+			V py = S::load(y + i);
+			V pz = S::load(z + i);
+			I xi = S::to_int(S::floor(px));
+			I yi = S::to_int(S::floor(py));
+			I zi = S::to_int(S::floor(pz));
+			V xf = S::sub(px, S::to_real(xi));
+			V yf = S::sub(py, S::to_real(yi));
+			V zf = S::sub(pz, S::to_real(zi));
+
+			V d1 = S::set1(std::numeric_limits<Real>::max());
+			V d2 = d1;
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				I hz = worley_hash<S>(
+					S::iset1((int)seed), S::iadd(zi, S::iset1(dz)));
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					I row = worley_hash<S>(hz, S::iadd(yi, S::iset1(dy)));
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						I h = worley_hash<S>(
+							row, S::iadd(xi, S::iset1(dx)));
+
+						// 10 bits of the hash per axis
+						V fx = S::add(
+							S::set1((Real)dx),
+							S::mul(S::to_real(S::iand(h, bits)), scale));
+						V fy = S::add(
+							S::set1((Real)dy),
+							S::mul(
+								S::to_real(S::iand(
+									S::template isrl<10>(h), bits)),
+								scale));
+						V fz = S::add(
+							S::set1((Real)dz),
+							S::mul(
+								S::to_real(S::iand(
+									S::template isrl<20>(h), bits)),
+								scale));
+
+						V ddx = S::sub(fx, xf);
+						V ddy = S::sub(fy, yf);
+						V ddz = S::sub(fz, zf);
+						V d = S::add(
+							S::add(S::mul(ddx, ddx), S::mul(ddy, ddy)),
+							S::mul(ddz, ddz));
+						d2 = S::min(d2, S::max(d1, d));
+						d1 = S::min(d1, d);
+					}
+				}
+			}
+			S::store(f1 + i, d1);
+			S::store(f2 + i, d2);
+		}
+		return n;
+	}
+}
+}
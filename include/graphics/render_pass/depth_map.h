@@ -64,11 +64,14 @@ public:
 			glm::vec3(0.0f, 1.0f, 0.0f));
 		light_vp = light_proj * light_view;
 		
-		shader.use();
-		shader.set_uniform("light_space_matrix", light_vp);
-
 		for (const auto &model : models)
-			model->draw(shader);
+		{
+			Shader &model_shader =
+				model->depth_shader ? *model->depth_shader : shader;
+			model_shader.use();
+			model_shader.set_uniform("light_space_matrix", light_vp);
+			model->draw(model_shader);
+		}
 		
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
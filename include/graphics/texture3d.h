@@ -0,0 +1,48 @@
+#ifndef LANDSCAPE_TEXTURE3D_H
+#define LANDSCAPE_TEXTURE3D_H
+
+#include <glad/glad.h>
+#include <graphics/texture.h>
+
+/// Single channel floating point 3D texture that repeats along every axis,
+/// e.g. for a Noise::BakedNoise table.
+class Texture3D
+{
+public:
+	/// Creates a 3D texture from provided data. `load` the texture before
+	/// use.
+	/// \param data Width * height * depth values, X fastest. The object
+	/// does not take ownership of the data and only reads it in `load`.
+	/// \param width Width in texels.
+	/// \param height Height in texels.
+	/// \param depth Depth in texels.
+	/// \param filter Filtering type to use.
+	Texture3D(
+		const float *data, int width, int height, int depth,
+		FilterType filter);
+
+	/// Destroys the texture.
+	~Texture3D();
+
+	Texture3D(const Texture3D &) = delete;
+	Texture3D &operator=(const Texture3D &) = delete;
+
+	/// Loads the texture to the GPU.
+	void load();
+
+	/// Retrieves the internal texture ID.
+	unsigned int id() const;
+
+	/// Uses the texture.
+	/// \param tex_unit Texture unit to use.
+	void use(GLenum tex_unit) const;
+private:
+	unsigned int identifier;	///< OpenGL identifier of the texture
+	const float *data;		///< Texel values
+	int width;			///< Width of the texture
+	int height;			///< Height of the texture
+	int depth;			///< Depth of the texture
+	FilterType tex_filter;		///< Filtering type
+};
+
+#endif //LANDSCAPE_TEXTURE3D_H
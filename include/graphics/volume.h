@@ -1,10 +1,18 @@
 #pragma once
 
 #include <stdint.h>
+#include <cmath>
+#include <cstring>
 #include <array>
+#include <vector>
+#include <string>
 #include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <aligned_array.h>
 #include <graphics/mesh.h>
 #include <logger.h>
+#include <parallel.h>
 
 #define VOL_DBG Log::Logger(Log::Level::Debug, "gfx.volume")
 
@@ -24,7 +32,7 @@ enum class Side {
     Top
 };
 
-std::string toString(GFX::Side side) {
+inline std::string toString(GFX::Side side) {
     switch (side)
     {
         case (Side::Back):
@@ -42,183 +50,863 @@ std::string toString(GFX::Side side) {
     }
 };
 
+/// Values of Voxel::material.
+enum class VoxelMaterial : uint16_t
+{
+    Empty = 0,
+    Stone,
+    Dirt,
+    Grass,
+    Sand,
+    Snow
+};
+
+/// One bit per voxel of a volume, set for solid voxels, packed along X
+/// into rows of 64-bit words. Row (y, z) is `row_words` words long, bits
+/// past x_size are 0. Every row holds a whole column of voxels, so the
+/// visible faces of a column are found with shifts and AND-NOTs against
+/// itself and its 4 neighbouring rows instead of per voxel lookups.
+struct Occupancy
+{
+    int x_size = 0, y_size = 0, z_size = 0;
+    int row_words = 0;
+    std::vector<uint64_t> words;
+
+    /// Returns the row of (y, z), or a row of empty voxels outside of the
+    /// volume.
+    const uint64_t *row(int y, int z) const
+    {
+        if (y < 0 || z < 0 || y >= y_size || z >= z_size)
+            return empty.data();
+        return &words[((size_t)z * y_size + y) * row_words];
+    }
+
+    /// Writes the voxels of word `w` of row (y, z) that have a face on
+    /// each side, indexed by Side. Voxels outside of the volume count as
+    /// empty.
+    void faces_at(int y, int z, int w, uint64_t faces[6]) const
+    {
+        const uint64_t *cur = row(y, z);
+        uint64_t solid = cur[w];
+        uint64_t low = (w > 0) ? cur[w - 1] >> 63 : 0;
+        uint64_t high = (w + 1 < row_words) ? cur[w + 1] << 63 : 0;
+
+        faces[(int)Side::Left] = solid & ~((solid << 1) | low);
+        faces[(int)Side::Right] = solid & ~((solid >> 1) | high);
+        faces[(int)Side::Bottom] = solid & ~row(y - 1, z)[w];
+        faces[(int)Side::Top] = solid & ~row(y + 1, z)[w];
+        faces[(int)Side::Back] = solid & ~row(y, z - 1)[w];
+        faces[(int)Side::Front] = solid & ~row(y, z + 1)[w];
+    }
+
+    void resize(int x, int y, int z)
+    {
+        x_size = x;
+        y_size = y;
+        z_size = z;
+        row_words = (x + 63) / 64;
+        words.assign((size_t)row_words * y * z, 0);
+        empty.assign(row_words, 0);
+    }
+
+private:
+    std::vector<uint64_t> empty;
+};
+
+/// A voxel as stored in a volume, 2 bytes.
 struct Voxel
 {
-    uint32_t material = 0;
+    uint16_t material = 0; ///< A VoxelMaterial, 0 for empty voxels.
+};
+
+/// Extra data of a voxel, kept in a side table of its volume for the few
+/// voxels that have any.
+struct VoxelData
+{
     uint64_t reserved = 0;
     uint64_t reserved_2 = 0;
 };
 
-template <int x_count, int y_count, int z_count>
-class Volume
+/// Voxel volume sized at runtime. Voxels are stored X fastest in a heap
+/// buffer aligned to cache lines, extra data in a sparse side table.
+class DynamicVolume
 {
 public:
-    Volume() {};
-    virtual ~Volume() {};
+    DynamicVolume(int x_size, int y_size, int z_size)
+        : x_dim(x_size), y_dim(y_size), z_dim(z_size),
+          voxels((size_t)x_size * y_size * z_size)
+    {};
+    virtual ~DynamicVolume() {};
 
+    /// Returns a voxel for writing, which marks the occupancy stale.
     Voxel &voxel_at(int x, int y, int z)
     {
-        return voxels.at(x_count * y_count * z + x_count * y + x);
+        occupancy_stale = true;
+        return voxels.at(index_for(x, y, z));
+    }
+
+    const Voxel &voxel_at(int x, int y, int z) const
+    {
+        return voxels.at(index_for(x, y, z));
     }
 
-    bool is_empty_at(int x, int y, int z)
+    bool is_empty_at(int x, int y, int z) const
     {
         return !((bool)voxel_at(x, y, z).material);
     }
 
+    /// Returns the extra data of a voxel, adding it if it has none.
+    VoxelData &data_at(int x, int y, int z)
+    {
+        return extra[checked_index_for(x, y, z)];
+    }
+
+    /// Returns the extra data of a voxel, or null if it has none.
+    const VoxelData *find_data_at(int x, int y, int z) const
+    {
+        auto it = extra.find(checked_index_for(x, y, z));
+        return (it != extra.end()) ? &it->second : nullptr;
+    }
+
+    /// Drops the extra data of a voxel, if any.
+    void erase_data_at(int x, int y, int z)
+    {
+        extra.erase(checked_index_for(x, y, z));
+    }
+
+    /// Returns the approximate heap and object bytes used by the volume.
+    size_t memory_usage() const
+    {
+        // Side table nodes hold the key, the value and a next pointer
+        size_t node = sizeof(size_t) + sizeof(VoxelData) + sizeof(void *);
+        return sizeof(*this) + voxels.size() * sizeof(Voxel)
+            + extra.size() * node + extra.bucket_count() * sizeof(void *)
+            + occupancy_bits.words.size() * sizeof(uint64_t);
+    }
+
+    /// Returns the solid voxels as bits, repacked from the voxels if any
+    /// was written to since the last call.
+    const Occupancy &occupancy()
+    {
+        if (occupancy_stale)
+            pack_occupancy();
+        return occupancy_bits;
+    }
+
+    int x_size() const { return x_dim; }
+    int y_size() const { return y_dim; }
+    int z_size() const { return z_dim; }
+
 private:
-    std::array<GFX::Voxel, x_count * y_count * z_count> voxels;
+    int x_dim, y_dim, z_dim;
+    AlignedArray<GFX::Voxel> voxels;
+    std::unordered_map<size_t, VoxelData> extra;
+    Occupancy occupancy_bits;
+    bool occupancy_stale = true;
+
+    void pack_occupancy()
+    {
+        occupancy_bits.resize(x_dim, y_dim, z_dim);
+        uint64_t *word = occupancy_bits.words.data();
+        const Voxel *voxel = voxels.data();
+
+        for (int iz = 0; iz < z_dim; iz++)
+        for (int iy = 0; iy < y_dim; iy++)
+        for (int w = 0; w < occupancy_bits.row_words; w++)
+        {
+            int count = std::min(64, x_dim - w * 64);
+            uint64_t bits = 0;
+            for (int i = 0; i < count; i++)
+                bits |= (uint64_t)(voxel[i].material != 0) << i;
+            *word++ = bits;
+            voxel += count;
+        }
+        occupancy_stale = false;
+    }
+
+    size_t index_for(int x, int y, int z) const
+    {
+        return (size_t)x_dim * y_dim * z + (size_t)x_dim * y + x;
+    }
+
+    /// index_for, throwing std::out_of_range outside of the volume.
+    size_t checked_index_for(int x, int y, int z) const
+    {
+        if (x < 0 || y < 0 || z < 0
+            || x >= x_dim || y >= y_dim || z >= z_dim)
+            throw std::out_of_range("DynamicVolume: voxel out of bounds");
+        return index_for(x, y, z);
+    }
 };
 
+/// Voxel volume with its size fixed at compile time. Stored on the heap
+/// like DynamicVolume, so large instances are fine as globals or locals.
 template <int x_count, int y_count, int z_count>
-class VolumeMesh : public GFX::Mesh
+class Volume : public DynamicVolume
 {
 public:
-    VolumeMesh(GFX::Volume<x_count, y_count, z_count> &volume, float vox_sz) 
-        : GFX::Mesh(), volume(volume), vox_sz(vox_sz)
+    Volume() : DynamicVolume(x_count, y_count, z_count) {};
+    virtual ~Volume() {};
+};
+
+/// Returns the 6 vertices of a voxel face as position, normal and UV.
+inline FaceVertArray face_verts(
+    GFX::Side side, int x, int y, int z, float vox_sz, float uv_scale)
+{
+    float cx = vox_sz * (float)x;
+    float cy = vox_sz * (float)y;
+    float cz = vox_sz * (float)z;
+
+    switch (side) 
     {
-        generate_from(volume);
-    };
+        case Side::Back:
+            return {
+                // Position                                                       // Normals         // UV 
+                cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, 0.0f,     0.0f,
+                cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, uv_scale, 0.0f,
+                cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, uv_scale, uv_scale,
+                cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, uv_scale, uv_scale,
+                cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, 0.0f,     uv_scale,
+                cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, 0.0f,     0.0f,
+            };
+        case Side::Front:
+            return {
+                cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, 0.0f,     0.0f,
+                cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, uv_scale, 0.0f,
+                cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, uv_scale, uv_scale,
+                cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, uv_scale, uv_scale,
+                cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, 0.0f,     uv_scale,
+                cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, 0.0f,     0.0f,
+            };
+        case Side::Left:
+            return {
+                cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, uv_scale, 0.0f,
+                cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, uv_scale, uv_scale,
+                cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, 0.0f,     uv_scale,
+                cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, 0.0f,     uv_scale,
+                cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, 0.0f,     0.0f,
+                cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, uv_scale, 0.0f,
+            };
+        case Side::Right:
+            return {
+                cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, uv_scale, 0.0f,
+                cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, uv_scale, uv_scale,
+                cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, 0.0f,     uv_scale,
+                cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, 0.0f,     uv_scale,
+                cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, 0.0f,     0.0f,
+                cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, uv_scale, 0.0f,
+            };
+        case Side::Bottom:
+            return {
+                cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, 0.0f,     uv_scale,
+                cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, uv_scale, uv_scale,
+                cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, uv_scale, 0.0f,
+                cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, uv_scale, 0.0f,
+                cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, 0.0f,     0.0f,
+                cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, 0.0f,     uv_scale,
+            };
+        case Side::Top:
+            return {
+                cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, 0.0f,     uv_scale,
+                cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, uv_scale, uv_scale,
+                cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, uv_scale, 0.0f,
+                cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, uv_scale, 0.0f,
+                cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, 0.0f,     0.0f,
+                cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, 0.0f,     uv_scale,
+            };
+        default:
+            throw std::invalid_argument("face_verts: invalid side");
+    }
+};
+
+/// Returns the 6 vertices of a face spanning x_count by y_count by z_count
+/// voxels from voxel (x, y, z), the count along the normal of the side
+/// being 1. UVs repeat once per voxel, like face_verts with a scale of 1.
+inline FaceVertArray quad_verts(
+    GFX::Side side, int x, int y, int z, int x_count, int y_count,
+    int z_count, float vox_sz)
+{
+    FaceVertArray verts = face_verts(side, x, y, z, vox_sz, 1.0f);
+    const float center[3] = { vox_sz * x, vox_sz * y, vox_sz * z };
+    const int counts[3] = { x_count, y_count, z_count };
+
+    // Axes the U and V coordinates of face_verts run along
+    int u_axis = (side == Side::Left || side == Side::Right) ? 1 : 0;
+    int v_axis = (side == Side::Back || side == Side::Front) ? 1 : 2;
 
-    virtual ~VolumeMesh() 
+    for (int i = 0; i < VERT_FACE_COUNT; i += VERT_STRIDE)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            if (verts[i + axis] > center[axis])
+                verts[i + axis] += (counts[axis] - 1) * vox_sz;
+        verts[i + 6] *= counts[u_axis];
+        verts[i + 7] *= counts[v_axis];
+    }
+    return verts;
+}
+
+/// How VolumeMesh turns visible voxel faces into triangles.
+enum class MeshingMode
+{
+    /// Two triangles per visible face.
+    Culled,
+
+    /// Coplanar faces of the same material merged into maximal
+    /// rectangles, two triangles each.
+    Greedy
+};
+
+/// Vertex layout of a VolumeMesh.
+enum class VertexFormat
+{
+    /// 8 floats per vertex: position, normal and UV, for
+    /// glsl/vertex.glsl.
+    Float,
+
+    /// One 32-bit word per vertex, for glsl/voxel_vertex.glsl. Bits 0-2
+    /// hold the Side of the face, 3-13 the material and 14-31 the corner
+    /// at 6 bits per axis, X first. Corners are voxel indices, shifted by
+    /// half a voxel, so volumes may have up to 63 voxels per side. UVs are
+    /// derived from the corner in the shader.
+    Packed32,
+
+    /// Two 32-bit words per vertex, for glsl/voxel_vertex.glsl. The first
+    /// is the Packed32 word, the second holds the next 4 bits of each
+    /// corner coordinate in bits 0-11 and the next 5 bits of the material
+    /// in bits 12-16, for up to 1023 voxels per side.
+    Packed64
+};
+
+/// Base of the indexed meshes of voxel faces, 4 vertices and 6 indices
+/// per face in a VertexFormat. Packed vertices are stored as 32-bit words
+/// in the vertex buffer, vert_stride counting words. The voxel_size
+/// uniform of the shader has to match `vox_sz`.
+class VoxelMesh : public GFX::Mesh
+{
+public:
+    virtual ~VoxelMesh()
     {
         free(verts);
+        free(indices);
     };
 
     void load() override {
         Mesh::load();
+        if (format != VertexFormat::Float)
+        {
+            add_vertex_attrib_uint_array(0, vert_stride, (void *)nullptr);
+            return;
+        }
         add_vertex_attrib_array(0, 3, (void *)nullptr);
-	    add_vertex_attrib_array(1, 3, (void *)(3 * sizeof(float)));
-	    add_vertex_attrib_array(2, 2, (void *)(6 * sizeof(float)));
+        add_vertex_attrib_array(1, 3, (void *)(3 * sizeof(float)));
+        add_vertex_attrib_array(2, 2, (void *)(6 * sizeof(float)));
     };
 
-private:
-    GFX::Volume<x_count, y_count, z_count> &volume;
+protected:
     float vox_sz;
+    VertexFormat format;
+
+    VoxelMesh(float vox_sz, VertexFormat format)
+        : GFX::Mesh(), vox_sz(vox_sz), format(format) {};
 
-    void generate_from(GFX::Volume<x_count, y_count, z_count> &volume)
+    /// Returns whether the corners of a volume of the given size fit the
+    /// vertex format.
+    bool fits(int x_size, int y_size, int z_size) const
     {
-        std::vector<float> verts;
+        int limit = (format == VertexFormat::Packed32) ? 63 : 1023;
+        return format == VertexFormat::Float
+            || std::max({ x_size, y_size, z_size }) <= limit;
+    };
 
-        for (int ix = 0; ix < x_count; ix++)
-        for (int iy = 0; iy < y_count; iy++)
-        for (int iz = 0; iz < z_count; iz++)
+    /// Merges the faces of a plane into maximal rectangles of faces of the
+    /// same material, taking the widest one along U first, and clears
+    /// them. Rows along U are `v_step` apart.
+    /// \param faces Material of every face of the plane, 0 for no face.
+    /// \param emit Called with the U and V of the first face, the width,
+    /// height and material of every rectangle.
+    template <typename F>
+    static void merge_plane(
+        uint16_t *faces, int u_size, int v_size, size_t u_step,
+        size_t v_step, F emit)
+    {
+        for (int v = 0; v < v_size; v++)
+        for (int u = 0; u < u_size; u++)
         {
-            if (volume.is_empty_at(ix, iy, iz)) 
-            {
+            size_t i = v * v_step + u * u_step;
+            uint16_t material = faces[i];
+            if (!material)
                 continue;
-            }
-                
-            if (ix == 0 || (ix > 0 && volume.is_empty_at(ix - 1, iy, iz))) 
+
+            int width = 1;
+            while (u + width < u_size
+                && faces[i + width * u_step] == material)
+                width++;
+
+            int height = 1;
+            for (; v + height < v_size; height++)
             {
-                for (auto &v : face_verts(Side::Left, ix, iy, iz, 1.0))
-                    verts.push_back(v);
+                size_t row = i + height * v_step;
+                int run = 0;
+                while (run < width && faces[row + run * u_step] == material)
+                    run++;
+                if (run < width)
+                    break;
             }
-            if (ix == x_count - 1 
-                || (ix < x_count - 1 && volume.is_empty_at(ix + 1, iy, iz))) 
-            {
-                for (auto &v : face_verts(Side::Right, ix, iy, iz, 1.0))
-                    verts.push_back(v);
-            }  
 
-            if (iy == 0 || (iy > 0 && volume.is_empty_at(ix, iy - 1, iz))) 
+            for (int dv = 0; dv < height; dv++)
+            for (int du = 0; du < width; du++)
+                faces[i + dv * v_step + du * u_step] = 0;
+
+            emit(u, v, width, height, material);
+        }
+    };
+
+    /// Appends the 4 distinct vertices of a face from face_verts or
+    /// quad_verts, whose triangles are vertices 0, 1, 2 and 2, 4, 0, in
+    /// the vertex format. Vertices are kept as 32-bit words, floats by
+    /// their bits.
+    void add_quad(
+        const FaceVertArray &face, Side side, uint16_t material,
+        std::vector<uint32_t> &verts, std::vector<unsigned int> &indices)
+        const
+    {
+        const int stride = words_per_vertex();
+        unsigned int base = verts.size() / stride;
+        for (int v : { 0, 1, 2, 4 })
+        {
+            const float *vert = &face[v * VERT_STRIDE];
+            if (format == VertexFormat::Float)
             {
-                for (auto &v : face_verts(Side::Bottom, ix, iy, iz, 1.0))
-                    verts.push_back(v);
+                uint32_t bits[VERT_STRIDE];
+                std::memcpy(bits, vert, sizeof(bits));
+                verts.insert(verts.end(), bits, bits + VERT_STRIDE);
+                continue;
             }
-            if (iy == y_count - 1 
-                || (iy < y_count - 1 && volume.is_empty_at(ix, iy + 1, iz))) 
+
+            // Corners sit half a voxel off the voxel centers
+            uint32_t corner[3];
+            for (int axis = 0; axis < 3; axis++)
+                corner[axis] = std::lround(vert[axis] / vox_sz + 0.5f);
+
+            verts.push_back(
+                (uint32_t)side | (material & 0x7ffu) << 3
+                | (corner[0] & 63) << 14 | (corner[1] & 63) << 20
+                | (corner[2] & 63) << 26);
+            if (format == VertexFormat::Packed64)
+                verts.push_back(
+                    (corner[0] >> 6) | (corner[1] >> 6) << 4
+                    | (corner[2] >> 6) << 8 | (uint32_t)(material >> 11) << 12);
+        }
+        for (unsigned int i : { 0, 1, 2, 2, 3, 0 })
+            indices.push_back(base + i);
+    };
+
+    int words_per_vertex() const
+    {
+        switch (format)
+        {
+            case VertexFormat::Packed32:
+                return 1;
+            case VertexFormat::Packed64:
+                return 2;
+            default:
+                return VERT_STRIDE;
+        }
+    };
+
+    void store(
+        const std::vector<uint32_t> &verts,
+        const std::vector<unsigned int> &indices)
+    {
+        this->verts = (float *)malloc(verts.size() * sizeof(uint32_t));
+        this->verts_count = verts.size() / words_per_vertex();
+        this->vert_stride = words_per_vertex();
+        std::memcpy(this->verts, verts.data(), verts.size() * sizeof(uint32_t));
+
+        this->indices =
+            (unsigned int *)malloc(indices.size() * sizeof(unsigned int));
+        this->idx_count = indices.size();
+        std::copy_n(indices.data(), indices.size(), this->indices);
+    };
+};
+
+/// Indexed mesh of the faces between solid and empty voxels of a volume,
+/// 4 vertices and 6 indices per face. Faces are culled a word of 64
+/// voxels at a time from the occupancy bits. V is any volume type with
+/// x_size, y_size, z_size, occupancy and voxel_at, such as DynamicVolume
+/// or Volume.
+template <typename V = GFX::DynamicVolume>
+class VolumeMesh : public VoxelMesh
+{
+public:
+    /// Throws std::invalid_argument if the volume is too large for a
+    /// packed `format`, see VoxelMesh.
+    VolumeMesh(
+        V &volume, float vox_sz, MeshingMode mode = MeshingMode::Culled,
+        VertexFormat format = VertexFormat::Float)
+        : VoxelMesh(vox_sz, format), volume(volume)
+    {
+        if (!fits(volume.x_size(), volume.y_size(), volume.z_size()))
+            throw std::invalid_argument("VolumeMesh: volume too large");
+
+        if (mode == MeshingMode::Greedy)
+            generate_greedy_from(volume);
+        else
+            generate_from(volume);
+    };
+
+private:
+    V &volume;
+
+    void generate_from(V &volume)
+    {
+        std::vector<uint32_t> verts;
+        std::vector<unsigned int> indices;
+        const Occupancy &occupancy = volume.occupancy();
+        const V &voxels = volume;
+
+        for (int iz = 0; iz < occupancy.z_size; iz++)
+        for (int iy = 0; iy < occupancy.y_size; iy++)
+        for (int w = 0; w < occupancy.row_words; w++)
+        {
+            if (!occupancy.row(iy, iz)[w])
+                continue;
+
+            uint64_t faces[6];
+            occupancy.faces_at(iy, iz, w, faces);
+            for (int side = 0; side < 6; side++)
+            for (uint64_t bits = faces[side]; bits; bits &= bits - 1)
             {
-                for (auto &v : face_verts(Side::Top, ix, iy, iz, 1.0))
-                    verts.push_back(v);
+                int ix = w * 64 + __builtin_ctzll(bits);
+                uint16_t material = (format == VertexFormat::Float)
+                    ? 0 : voxels.voxel_at(ix, iy, iz).material;
+                add_quad(
+                    face_verts((Side)side, ix, iy, iz, vox_sz, 1.0),
+                    (Side)side, material, verts, indices);
             }
+        }
+
+        store(verts, indices);
+    };
+
+    void generate_greedy_from(V &volume)
+    {
+        std::vector<uint32_t> verts;
+        std::vector<unsigned int> indices;
+        const Occupancy &occupancy = volume.occupancy();
+        const V &voxels = volume;
 
-            if (iz == 0 || (iz > 0 && volume.is_empty_at(ix, iy, iz - 1))) 
+        const int size[3] = {
+            occupancy.x_size, occupancy.y_size, occupancy.z_size };
+        const size_t stride[3] = {
+            1, (size_t)size[0], (size_t)size[0] * size[1] };
+
+        // Material of the voxels with a face on the side being meshed, 0
+        // for the others. Merged faces are cleared as they are emitted
+        std::vector<uint16_t> faces(stride[2] * size[2], 0);
+
+        for (int side = 0; side < 6; side++)
+        {
+            for (int iz = 0; iz < size[2]; iz++)
+            for (int iy = 0; iy < size[1]; iy++)
+            for (int w = 0; w < occupancy.row_words; w++)
             {
-                for (auto &v : face_verts(Side::Back, ix, iy, iz, 1.0))
-                    verts.push_back(v);
+                uint64_t bits[6];
+                occupancy.faces_at(iy, iz, w, bits);
+                for (uint64_t b = bits[side]; b; b &= b - 1)
+                {
+                    int ix = w * 64 + __builtin_ctzll(b);
+                    faces[iz * stride[2] + iy * stride[1] + ix] =
+                        voxels.voxel_at(ix, iy, iz).material;
+                }
             }
-            if (iz == z_count - 1 
-                || (iz < z_count - 1 && volume.is_empty_at(ix, iy, iz + 1))) 
+
+            // Planes are perpendicular to the normal axis, merged along
+            // the U and V axes of face_verts
+            int n_axis = (side <= (int)Side::Front) ? 2
+                : (side <= (int)Side::Right) ? 0 : 1;
+            int u_axis = (n_axis == 0) ? 1 : 0;
+            int v_axis = (n_axis == 2) ? 1 : 2;
+            const size_t u_step = stride[u_axis], v_step = stride[v_axis];
+
+            for (int p = 0; p < size[n_axis]; p++)
+                merge_plane(
+                    &faces[p * stride[n_axis]], size[u_axis], size[v_axis],
+                    u_step, v_step,
+                    [&](int u, int v, int width, int height, uint16_t material)
+                    {
+                        int at[3], counts[3] = { 1, 1, 1 };
+                        at[n_axis] = p;
+                        at[u_axis] = u;
+                        at[v_axis] = v;
+                        counts[u_axis] = width;
+                        counts[v_axis] = height;
+                        add_quad(
+                            quad_verts(
+                                (Side)side, at[0], at[1], at[2],
+                                counts[0], counts[1], counts[2], vox_sz),
+                            (Side)side, material, verts, indices);
+                    });
+        }
+
+        store(verts, indices);
+    };
+};
+
+/// Mesh of the faces between solid and empty voxels of a volume that is
+/// generated slice by slice, such as Noise::VolumeSlices. Only the Z slice
+/// being meshed and its two neighbours are kept at a time, so neither the
+/// noise nor the voxels of the whole volume are ever stored. Produces the
+/// same faces as VolumeMesh over the same voxels, ordered by Z first.
+/// S is any slice source with x_size, y_size, z_size and slice(z, out),
+/// writing an X fastest slice of bytes that are non-zero for solid voxels.
+/// The bytes are the VoxelMaterial of packed vertices, so the 1 of a
+/// thresholded slice is Stone.
+///
+/// Greedy meshing merges the faces of each Z slice along X and Y, and
+/// carries the rectangles on to the next slice while it has the same
+/// faces under them, so it needs no more of the volume than the window.
+/// Rectangles end at slab boundaries, so each slab beyond the first adds
+/// a few faces to those of a greedy VolumeMesh.
+template <typename S>
+class StreamedVolumeMesh : public VoxelMesh
+{
+public:
+    /// Throws std::invalid_argument if the volume is too large for a
+    /// packed `format`, see VoxelMesh.
+    /// \param threads Worker threads to split the volume across in Z
+    /// slabs, each with its own window. Every slab but the first
+    /// evaluates two slices more. 0 uses all hardware threads.
+    StreamedVolumeMesh(
+        const S &source, float vox_sz, int threads = 1,
+        MeshingMode mode = MeshingMode::Culled,
+        VertexFormat format = VertexFormat::Float)
+        : VoxelMesh(vox_sz, format), mode(mode)
+    {
+        if (!fits(source.x_size(), source.y_size(), source.z_size()))
+            throw std::invalid_argument(
+                "StreamedVolumeMesh: volume too large");
+
+        generate_from(source, threads);
+    };
+
+private:
+    MeshingMode mode;
+
+    /// Vertices and indices of a slab, indices counting from its first
+    /// vertex.
+    struct Slab
+    {
+        std::vector<uint32_t> verts;
+        std::vector<unsigned int> indices;
+    };
+
+    /// Rectangle of faces of a side whose plane runs along Z, still
+    /// growing along Z. `p` is its plane along the normal axis, `u` its
+    /// first face along the other axis of the slice.
+    struct OpenQuad
+    {
+        int p, u, width;
+        int z;
+        uint16_t material;
+    };
+
+    void generate_from(const S &source, int threads)
+    {
+        const int z_count = source.z_size();
+
+        // Slabs mesh into their own buffers, indexed by their first
+        // slice, and are joined in order
+        std::vector<Slab> slabs(z_count);
+        Parallel::for_ranges(0, z_count, threads, [&](int z_from, int z_to)
+        {
+            mesh_slab(source, z_from, z_to, slabs[z_from]);
+        });
+
+        size_t verts_size = 0, indices_size = 0;
+        for (auto &slab : slabs)
+        {
+            verts_size += slab.verts.size();
+            indices_size += slab.indices.size();
+        }
+
+        std::vector<uint32_t> verts;
+        std::vector<unsigned int> indices;
+        verts.reserve(verts_size);
+        indices.reserve(indices_size);
+        for (auto &slab : slabs)
+        {
+            unsigned int base = verts.size() / words_per_vertex();
+            verts.insert(verts.end(), slab.verts.begin(), slab.verts.end());
+            for (unsigned int i : slab.indices)
+                indices.push_back(base + i);
+        }
+
+        store(verts, indices);
+    };
+
+    /// Meshes the [z_from, z_to) slab, keeping a window of 3 slices.
+    void mesh_slab(
+        const S &source, int z_from, int z_to, Slab &slab) const
+    {
+        const int x_count = source.x_size();
+        const int y_count = source.y_size();
+        const int z_count = source.z_size();
+        const size_t slice_size = (size_t)x_count * y_count;
+
+        // Slice z lives in slot z mod 3, so loading z + 1 overwrites z - 2
+        std::vector<unsigned char> window(3 * slice_size);
+        auto slot = [&](int iz) {
+            return &window[(iz + 3) % 3 * slice_size];
+        };
+
+        if (z_from > 0)
+            source.slice(z_from - 1, slot(z_from - 1));
+        source.slice(z_from, slot(z_from));
+
+        // Greedy meshing collects the faces of each side of a slice
+        // before merging them, see merge_slice
+        std::vector<uint16_t> planes;
+        std::vector<OpenQuad> open[6];
+        if (mode == MeshingMode::Greedy)
+            planes.assign(6 * slice_size, 0);
+
+        for (int iz = z_from; iz < z_to; iz++)
+        {
+            if (iz + 1 < z_count)
+                source.slice(iz + 1, slot(iz + 1));
+
+            const unsigned char *prev = (iz > 0) ? slot(iz - 1) : nullptr;
+            const unsigned char *cur = slot(iz);
+            const unsigned char *next =
+                (iz + 1 < z_count) ? slot(iz + 1) : nullptr;
+
+            for (int iy = 0; iy < y_count; iy++)
+            for (int ix = 0; ix < x_count; ix++)
             {
-                for (auto &v : face_verts(Side::Front, ix, iy, iz, 1.0))
-                    verts.push_back(v);
+                size_t i = (size_t)iy * x_count + ix;
+                if (!cur[i])
+                    continue;
+
+                bool faces[6];
+                faces[(int)Side::Left] = ix == 0 || !cur[i - 1];
+                faces[(int)Side::Right] = ix == x_count - 1 || !cur[i + 1];
+                faces[(int)Side::Bottom] = iy == 0 || !cur[i - x_count];
+                faces[(int)Side::Top] =
+                    iy == y_count - 1 || !cur[i + x_count];
+                faces[(int)Side::Back] = !prev || !prev[i];
+                faces[(int)Side::Front] = !next || !next[i];
+
+                for (int side = 0; side < 6; side++)
+                {
+                    if (!faces[side])
+                        continue;
+                    if (mode == MeshingMode::Greedy)
+                        planes[side * slice_size + i] = cur[i];
+                    else
+                        add_quad(
+                            face_verts((Side)side, ix, iy, iz, vox_sz, 1.0),
+                            (Side)side, cur[i], slab.verts, slab.indices);
+                }
             }
-        }
 
-        // Can do without a copy if not using std::array
-        this->verts = (float *)malloc(verts.size() * sizeof(float));
-        this->verts_count = verts.size() / VERT_STRIDE;
-        this->vert_stride = VERT_STRIDE;
+            if (mode == MeshingMode::Greedy)
+                merge_slice(
+                    planes.data(), x_count, y_count, iz, open, slab);
+        }
 
-        std::copy_n(verts.data(), verts.size(), this->verts);
+        for (int side = 0; side < 6; side++)
+            for (const OpenQuad &quad : open[side])
+                close_quad((Side)side, quad, z_to, slab);
     };
 
-    FaceVertArray face_verts(GFX::Side side, int x, int y, int z, float uv_scale)
+    /// Merges the faces of slice `iz`, cleared as they are merged.
+    /// Back and Front faces are merged into rectangles within the slice.
+    /// Faces of the other sides extend the open rectangles they fully
+    /// cover into the slice, the rest start new ones. Rectangles that
+    /// can't be extended are emitted.
+    /// \param planes Material of the faces of each side, one X fastest
+    /// slice per side, 0 for no face.
+    void merge_slice(
+        uint16_t *planes, int x_count, int y_count, int iz,
+        std::vector<OpenQuad> open[6], Slab &slab) const
     {
-        float cx = vox_sz * (float)x;
-        float cy = vox_sz * (float)y;
-        float cz = vox_sz * (float)z;
+        const size_t slice_size = (size_t)x_count * y_count;
+        for (Side side : { Side::Back, Side::Front })
+            merge_plane(
+                planes + (int)side * slice_size, x_count, y_count, 1,
+                x_count,
+                [&](int u, int v, int width, int height, uint16_t material)
+                {
+                    add_quad(
+                        quad_verts(side, u, v, iz, width, height, 1, vox_sz),
+                        side, material, slab.verts, slab.indices);
+                });
 
-        switch (side) 
+        for (Side side : { Side::Left, Side::Right, Side::Bottom, Side::Top })
         {
-            case Side::Back:
-                return {
-                    // Position                                                       // Normals         // UV 
-                    cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, 0.0f,     0.0f,
-                    cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, uv_scale, 0.0f,
-                    cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, uv_scale, uv_scale,
-                    cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, uv_scale, uv_scale,
-                    cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, 0.0f,     uv_scale,
-                    cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 0.0f, -1.0f, 0.0f,     0.0f,
-                };
-            case Side::Front:
-                return {
-                    cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, 0.0f,     0.0f,
-                    cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, uv_scale, 0.0f,
-                    cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, uv_scale, uv_scale,
-                    cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, uv_scale, uv_scale,
-                    cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, 0.0f,     uv_scale,
-                    cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 0.0f, 1.0f, 0.0f,     0.0f,
-                };
-            case Side::Left:
-                return {
-                    cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, uv_scale, 0.0f,
-                    cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, uv_scale, uv_scale,
-                    cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, 0.0f,     uv_scale,
-                    cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, 0.0f,     uv_scale,
-                    cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, 0.0f,     0.0f,
-                    cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), -1.0f, 0.0f, 0.0f, uv_scale, 0.0f,
-                };
-            case Side::Right:
-                return {
-                    cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, uv_scale, 0.0f,
-                    cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, uv_scale, uv_scale,
-                    cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, 0.0f,     uv_scale,
-                    cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, 0.0f,     uv_scale,
-                    cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, 0.0f,     0.0f,
-                    cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 1.0f, 0.0f, 0.0f, uv_scale, 0.0f,
-                };
-            case Side::Bottom:
-                return {
-                    cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, 0.0f,     uv_scale,
-                    cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, uv_scale, uv_scale,
-                    cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, uv_scale, 0.0f,
-                    cx + (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, uv_scale, 0.0f,
-                    cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, 0.0f,     0.0f,
-                    cx - (vox_sz / 2.0f), cy - (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, -1.0f, 0.0f, 0.0f,     uv_scale,
-                };
-            case Side::Top:
-                return {
-            		cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, 0.0f,     uv_scale,
-                    cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, uv_scale, uv_scale,
-                    cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, uv_scale, 0.0f,
-                    cx + (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, uv_scale, 0.0f,
-                    cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz + (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, 0.0f,     0.0f,
-                    cx - (vox_sz / 2.0f), cy + (vox_sz / 2.0f), cz - (vox_sz / 2.0f), 0.0f, 1.0f, 0.0f, 0.0f,     uv_scale,
-                };
+            // Left and Right planes are along X, rows along Y, and the
+            // other way around for Bottom and Top
+            bool x_normal = (side == Side::Left || side == Side::Right);
+            const int p_count = x_normal ? x_count : y_count;
+            const int u_count = x_normal ? y_count : x_count;
+            const size_t p_step = x_normal ? 1 : x_count;
+            const size_t u_step = x_normal ? x_count : 1;
+            uint16_t *faces = planes + (int)side * slice_size;
+
+            std::vector<OpenQuad> &quads = open[(int)side];
+            std::vector<OpenQuad> kept;
+            for (const OpenQuad &quad : quads)
+            {
+                size_t i = quad.p * p_step + quad.u * u_step;
+                int run = 0;
+                while (run < quad.width
+                    && faces[i + run * u_step] == quad.material)
+                    run++;
+                if (run < quad.width)
+                {
+                    close_quad(side, quad, iz, slab);
+                    continue;
+                }
+                for (int du = 0; du < quad.width; du++)
+                    faces[i + du * u_step] = 0;
+                kept.push_back(quad);
+            }
+
+            for (int p = 0; p < p_count; p++)
+            for (int u = 0; u < u_count; u++)
+            {
+                size_t i = p * p_step + u * u_step;
+                uint16_t material = faces[i];
+                if (!material)
+                    continue;
+
+                int width = 1;
+                while (u + width < u_count
+                    && faces[i + width * u_step] == material)
+                    width++;
+                for (int du = 0; du < width; du++)
+                    faces[i + du * u_step] = 0;
+                kept.push_back({ p, u, width, iz, material });
+            }
+            quads.swap(kept);
         }
     };
+
+    /// Emits an open rectangle that extends up to slice `z_end`.
+    void close_quad(Side side, const OpenQuad &quad, int z_end, Slab &slab)
+        const
+    {
+        bool x_normal = (side == Side::Left || side == Side::Right);
+        int x = x_normal ? quad.p : quad.u;
+        int y = x_normal ? quad.u : quad.p;
+        int x_len = x_normal ? 1 : quad.width;
+        int y_len = x_normal ? quad.width : 1;
+        add_quad(
+            quad_verts(
+                side, x, y, quad.z, x_len, y_len, z_end - quad.z, vox_sz),
+            side, quad.material, slab.verts, slab.indices);
+    };
 };
 
 }
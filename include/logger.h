@@ -13,7 +13,7 @@ enum class Level {
     Critical
 };
 
-Log::Level global_level = Log::Level::Debug;
+inline Log::Level global_level = Log::Level::Debug;
 
 class Logger {
 public:
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/// Thread safe cache of shared immutable values that evicts the least
+/// recently used ones once their total cost exceeds a budget. Values are
+/// handed out as shared pointers, so evicting one never invalidates it
+/// for a caller still holding it.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class LruCache
+{
+public:
+	/// Counters since creation or the last `clear`.
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t evictions = 0;
+		size_t entries = 0;
+		size_t cost = 0;	///< Total cost of the cached values.
+	};
+
+	/// \param budget Total cost the cached values may reach, e.g. bytes.
+	LruCache(size_t budget) : budget(budget) {};
+
+	LruCache(const LruCache &) = delete;
+	LruCache &operator=(const LruCache &) = delete;
+
+	/// Returns the value of `key` and marks it as most recently used, or
+	/// null if it isn't cached.
+	std::shared_ptr<const V> find(const K &key)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto it = index.find(key);
+		if (it == index.end())
+		{
+			counters.misses++;
+			return nullptr;
+		}
+
+		counters.hits++;
+		entries.splice(entries.begin(), entries, it->second);
+		return it->second->value;
+	};
+
+	/// Caches `value` under `key` as most recently used and evicts least
+	/// recently used values until the budget is met again. A value costing
+	/// more than the whole budget isn't cached. If the key is cached
+	/// already, the cached value is kept and returned.
+	std::shared_ptr<const V> insert(
+		const K &key, std::shared_ptr<const V> value, size_t cost)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto it = index.find(key);
+		if (it != index.end())
+			return it->second->value;
+		if (cost > budget)
+			return value;
+
+		entries.push_front({ key, value, cost });
+		index.emplace(key, entries.begin());
+		counters.cost += cost;
+
+		while (counters.cost > budget)
+		{
+			Entry &last = entries.back();
+			counters.cost -= last.cost;
+			counters.evictions++;
+			index.erase(last.key);
+			entries.pop_back();
+		}
+		return value;
+	};
+
+	/// Returns the value of `key`, creating and caching it with make() on
+	/// a miss. make runs without the lock held, so concurrent misses of
+	/// different keys don't wait on each other, and concurrent misses of
+	/// the same key may both run it.
+	/// \param make Returns a std::shared_ptr<const V> for the key.
+	/// \param cost Returns the cost of a value made by make.
+	template <typename Make, typename Cost>
+	std::shared_ptr<const V> get(const K &key, Make &&make, Cost &&cost)
+	{
+		if (std::shared_ptr<const V> value = find(key))
+			return value;
+
+		std::shared_ptr<const V> value = make();
+		return insert(key, value, cost(*value));
+	};
+
+	/// Drops every value and resets the counters.
+	void clear()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		index.clear();
+		entries.clear();
+		counters = Stats();
+	};
+
+	Stats stats() const
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		Stats current = counters;
+		current.entries = entries.size();
+		return current;
+	};
+private:
+	struct Entry
+	{
+		K key;
+		std::shared_ptr<const V> value;
+		size_t cost;
+	};
+
+	size_t budget;
+	Stats counters;
+	mutable std::mutex lock;
+
+	/// Most recently used first.
+	std::list<Entry> entries;
+	std::unordered_map<K, typename std::list<Entry>::iterator, Hash> index;
+};
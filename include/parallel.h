@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace Parallel
+{
+	/// Returns the amount of hardware threads, at least 1.
+	inline int hardware_threads()
+	{
+		return std::max(1, (int)std::thread::hardware_concurrency());
+	}
+	
+	/// Splits [begin, end) into up to `threads` contiguous ranges and calls
+	/// fn(from, to) for each of them on its own thread. The calling thread
+	/// takes the first range. Returns once all ranges are done.
+	/// \param begin First index.
+	/// \param end One past the last index.
+	/// \param threads Thread count. 0 uses all hardware threads.
+	/// \param fn Callable taking (int from, int to).
+	template <typename F>
+	void for_ranges(int begin, int end, int threads, F &&fn)
+	{
+		int count = end - begin;
+		if (count <= 0)
+			return;
+		if (threads <= 0)
+			threads = hardware_threads();
+		threads = std::min(threads, count);
+		
+		if (threads == 1)
+		{
+			fn(begin, end);
+			return;
+		}
+		
+		// Spread the remainder over the leading ranges
+		int chunk = count / threads;
+		int extra = count % threads;
+		
+		std::vector<std::thread> workers;
+		workers.reserve(threads - 1);
+		int from = begin + chunk + (extra > 0);
+		for (int t = 1; t < threads; t++)
+		{
+			int to = from + chunk + (t < extra);
+			workers.emplace_back([&fn, from, to] { fn(from, to); });
+			from = to;
+		}
+		
+		fn(begin, begin + chunk + (extra > 0));
+		
+		for (auto &worker : workers)
+			worker.join();
+	}
+}
@@ -0,0 +1,1109 @@
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <graphics/noise.h>
+#include <graphics/noise/erosion.h>
+#include <graphics/noise/biome.h>
+#include <graphics/noise/baked.h>
+#include <graphics/noise/chunk_noise.h>
+#include <graphics/noise/graph.h>
+#include <graphics/volume.h>
+
+// Noise generation and meshing benchmarks. Needs no window or GL context,
+// so it runs on headless machines. Prints a single JSON document, one
+// result per case, meant to be kept and diffed release over release.
+//
+//     landscape_bench [--quick] [--repeats N] [--out results.json]
+//
+// With --verify it instead checks the thresholding shortcuts and batched
+// paths against the scalar noise, and streamed meshes against meshes of
+// the whole volume, and exits with 1 on any mismatch.
+
+namespace
+{
+	/// Benchmark settings from the command line.
+	struct Options
+	{
+		bool quick = false;	///< Smaller sizes and fewer cases.
+		int repeats = 0;	///< Timed runs per case, 0 picks 5 or 2 when
+					///< quick.
+		const char *out = nullptr; ///< Output file, stdout if null.
+		bool verify = false;	///< Check results instead of timing.
+	};
+
+	/// Timings of a single case.
+	struct Result
+	{
+		std::string name;
+		std::vector<std::pair<std::string, std::string>> params;
+		long long samples;	///< Noise samples, voxels or erosion cell
+					///< steps per run.
+		double min_ms;
+		double median_ms;
+	};
+
+	/// Keeps results alive so the compiler can't drop the work.
+	volatile double sink;
+
+	/// Runs fn once untimed and `repeats` times timed.
+	Result
+	measure(
+		const char *name,
+		std::vector<std::pair<std::string, std::string>> params,
+		long long samples, int repeats, const std::function<void()> &fn)
+	{
+		fn();
+
+		std::vector<double> times;
+		for (int i = 0; i < repeats; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			fn();
+			auto end = std::chrono::steady_clock::now();
+			times.push_back(
+				std::chrono::duration<double, std::milli>(end - start)
+				.count());
+		}
+		std::sort(times.begin(), times.end());
+
+		std::fprintf(
+			stderr, "%-24s %10.3f ms\n", name, times[times.size() / 2]);
+		return { name, params, samples, times.front(),
+			times[times.size() / 2] };
+	}
+
+	std::string
+	str(int value)
+	{
+		return std::to_string(value);
+	}
+
+	std::string
+	str(bool value)
+	{
+		return value ? "true" : "false";
+	}
+
+	std::string
+	str(const char *value)
+	{
+		return std::string("\"") + value + "\"";
+	}
+
+	const char *
+	to_string(Noise::Precision precision)
+	{
+		return (precision == Noise::Precision::Float) ? "float" : "double";
+	}
+
+	/// Returns the instruction sets the running CPU supports, lowest
+	/// first.
+	std::vector<Noise::SimdLevel>
+	simd_levels()
+	{
+		std::vector<Noise::SimdLevel> levels;
+		for (Noise::SimdLevel level : {
+			Noise::SimdLevel::Scalar, Noise::SimdLevel::SSE41,
+			Noise::SimdLevel::AVX2 })
+		{
+			if (level <= Noise::supported_simd_level())
+				levels.push_back(level);
+		}
+		return levels;
+	}
+
+	/// Returns the thread counts to run with, 1 and all hardware
+	/// threads.
+	std::vector<int>
+	thread_counts()
+	{
+		std::vector<int> counts = { 1 };
+		if (Parallel::hardware_threads() > 1)
+			counts.push_back(Parallel::hardware_threads());
+		return counts;
+	}
+
+	/// Point coordinates spread over a few noise periods, laid out as
+	/// separate arrays like the batch functions take them.
+	template <typename Real>
+	struct Points
+	{
+		std::vector<Real> x, y, z;
+
+		Points(int count) : x(count), y(count), z(count)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				x[i] = (Real)((i % 64) * 0.0625);
+				y[i] = (Real)((i / 64 % 64) * 0.0625);
+				z[i] = (Real)((i / 4096) * 0.0625);
+			}
+		};
+	};
+
+	/// Per point noise and octave_noise through the virtual interfaces.
+	void
+	bench_point_calls(const Options &opts, std::vector<Result> &results)
+	{
+		const int count = opts.quick ? 1 << 16 : 1 << 20;
+		Points<double> pts(count);
+		Noise::Perlin perlin;
+
+		const Noise::Generator &gen = perlin;
+		results.push_back(measure(
+			"perlin.noise", {}, count, opts.repeats, [&]
+			{
+				double sum = 0;
+				for (int i = 0; i < count; i++)
+					sum += gen.noise(pts.x[i], pts.y[i], pts.z[i]);
+				sink = sum;
+			}));
+
+		const Noise::OctavedGenerator &octaved = perlin;
+		for (int octaves : { 1, 4, 8 })
+		{
+			results.push_back(measure(
+				"perlin.octave_noise", { { "octaves", str(octaves) } },
+				count, opts.repeats, [&]
+				{
+					double sum = 0;
+					for (int i = 0; i < count; i++)
+						sum += octaved.octave_noise(
+							pts.x[i], pts.y[i], pts.z[i], octaves, 0.5);
+					sink = sum;
+				}));
+		}
+	}
+
+	/// octave_noise_batch and octave_threshold_batch of a generator in
+	/// Real precision, at 4 octaves and at the 6 the simplex and Perlin
+	/// comparison is made at. Generators with vector kernels run at every
+	/// supported instruction set.
+	template <typename Real>
+	void
+	bench_batches(
+		const Options &opts, const char *generator,
+		const Noise::OctavedGenerator &gen, bool vectorized,
+		std::vector<Result> &results)
+	{
+		const int count = opts.quick ? 1 << 16 : 1 << 20;
+		Points<Real> pts(count);
+		std::vector<Real> out(count);
+		std::vector<unsigned char> mask(count);
+		const char *precision = std::is_same<Real, float>::value
+			? "float" : "double";
+
+		std::vector<Noise::SimdLevel> levels = vectorized
+			? simd_levels()
+			: std::vector<Noise::SimdLevel>{ Noise::simd_level() };
+		for (Noise::SimdLevel level : levels)
+		for (int octaves : { 4, 6 })
+		{
+			Noise::set_simd_level(level);
+			auto params = std::vector<std::pair<std::string, std::string>>{
+				{ "generator", str(generator) },
+				{ "precision", str(precision) },
+				{ "simd", str(Noise::to_string(level)) },
+				{ "octaves", str(octaves) } };
+
+			results.push_back(measure(
+				"octave_noise_batch", params, count, opts.repeats, [&]
+				{
+					gen.octave_noise_batch(
+						pts.x.data(), pts.y.data(), pts.z.data(),
+						out.data(), count, octaves, (Real)0.5);
+					sink = out[count - 1];
+				}));
+			results.push_back(measure(
+				"octave_threshold_batch", params, count, opts.repeats, [&]
+				{
+					gen.octave_threshold_batch(
+						pts.x.data(), pts.y.data(), pts.z.data(),
+						mask.data(), count, octaves, (Real)0.5, 0.5);
+					sink = mask[count - 1];
+				}));
+		}
+		Noise::set_simd_level(Noise::supported_simd_level());
+	}
+
+	/// Checks octave_threshold_batch and octave_sample_above of a
+	/// generator against thresholding octave_noise_batch in Real
+	/// precision, at every supported instruction set. The points include
+	/// negative coordinates and leave a tail shorter than a vector.
+	/// \return Amount of mismatching points.
+	template <typename Real, typename G>
+	long long
+	verify_thresholds(const char *generator, const G &gen)
+	{
+		const int count = 4099;
+		std::vector<Real> x(count), y(count), z(count), noise(count);
+		std::vector<unsigned char> mask(count);
+		for (int i = 0; i < count; i++)
+		{
+			x[i] = (Real)((i % 61) * 0.173 - 3.0);
+			y[i] = (Real)((i / 61 % 67) * 0.129 - 2.0);
+			z[i] = (Real)((i % 13) * 0.311 + (i / 61) * 0.007 - 1.0);
+		}
+		const char *precision = std::is_same<Real, float>::value
+			? "float" : "double";
+
+		long long mismatches = 0;
+		for (Noise::SimdLevel level : simd_levels())
+		for (int octaves : { 1, 2, 4, 6, 8 })
+		for (Real persistence : { (Real)0.5, (Real)0.65 })
+		for (double threshold : { 0.3, 0.45, 0.5, 0.55, 0.6, 0.7 })
+		{
+			Noise::set_simd_level(level);
+			gen.octave_noise_batch(
+				x.data(), y.data(), z.data(), noise.data(), count,
+				octaves, persistence);
+			gen.octave_threshold_batch(
+				x.data(), y.data(), z.data(), mask.data(), count,
+				octaves, persistence, threshold);
+			for (int i = 0; i < count; i++)
+			{
+				bool expected = noise[i] > threshold;
+				bool above = gen.template octave_sample_above<Real>(
+					x[i], y[i], z[i], octaves, persistence, threshold);
+				if ((bool)mask[i] == expected && above == expected)
+					continue;
+				if (mismatches++ < 10)
+					std::fprintf(
+						stderr,
+						"%s %s %s octaves %d persistence %g threshold "
+						"%g: point %d noise %.9g batch %d above %d\n",
+						generator, precision, Noise::to_string(level),
+						octaves, (double)persistence, threshold, i,
+						(double)noise[i], mask[i], (int)above);
+			}
+		}
+		Noise::set_simd_level(Noise::supported_simd_level());
+		return mismatches;
+	}
+
+	/// Checks octave_noise_batch of a generator in Real precision
+	/// against octave_sample rounded to Real, which the batch must match
+	/// exactly at every supported instruction set.
+	/// \return Amount of mismatching points.
+	template <typename Real, typename G>
+	long long
+	verify_batch(const char *generator, const G &gen)
+	{
+		const int count = 4099;
+		std::vector<Real> x(count), y(count), z(count), noise(count);
+		for (int i = 0; i < count; i++)
+		{
+			x[i] = (Real)((i % 61) * 0.073 - 1.0);
+			y[i] = (Real)((i / 61 % 67) * 0.129 - 2.0);
+			z[i] = (Real)((i / 61) * 0.007 + 0.5);
+		}
+		const char *precision = std::is_same<Real, float>::value
+			? "float" : "double";
+
+		long long mismatches = 0;
+		for (Noise::SimdLevel level : simd_levels())
+		for (int octaves : { 1, 4, 8 })
+		{
+			Noise::set_simd_level(level);
+			gen.octave_noise_batch(
+				x.data(), y.data(), z.data(), noise.data(), count,
+				octaves, (Real)0.5);
+			for (int i = 0; i < count; i++)
+			{
+				Real expected = (Real)gen.octave_sample(
+					x[i], y[i], z[i], octaves, 0.5);
+				if (noise[i] == expected)
+					continue;
+				if (mismatches++ < 10)
+					std::fprintf(
+						stderr,
+						"%s %s %s octaves %d: point %d batch %.9g "
+						"sample %.9g\n",
+						generator, precision, Noise::to_string(level),
+						octaves, i, (double)noise[i], (double)expected);
+			}
+		}
+		Noise::set_simd_level(Noise::supported_simd_level());
+		return mismatches;
+	}
+
+	/// Checks Noise::Graph recipes against the generators they are built
+	/// from:
+	/// - fBm over a Perlin source equals Perlin's octave_noise.
+	/// - Recipes over Perlin noise at negative coordinates equal them
+	///   256 units further, as sources wrap periodic noise, and the
+	///   example recipe of graph.h stays in range there.
+	/// - Recipe::octave_threshold_batch equals thresholding each sample,
+	///   in both precisions.
+	/// \return Amount of mismatching points.
+	long long
+	verify_graph()
+	{
+		// The example recipe of graph.h
+		Noise::Perlin perlin;
+		Noise::Simplex simplex;
+		auto terrain = Noise::Graph::select(
+			Noise::Graph::fbm(Noise::Graph::source(perlin), 4, 0.5),
+			Noise::Graph::ridged(Noise::Graph::source(perlin), 6, 0.45),
+			Noise::Graph::warp(
+				Noise::Graph::fbm(Noise::Graph::source(simplex), 3, 0.5),
+				Noise::Graph::fbm(Noise::Graph::source(perlin), 2, 0.5),
+				0.25),
+			0.55, 0.05);
+		auto recipe = Noise::Graph::recipe(terrain);
+
+		// Perlin noise only and no warp, whose offsets round differently
+		// 256 units further, so that it repeats exactly
+		auto ridges = Noise::Graph::select(
+			Noise::Graph::fbm(Noise::Graph::source(perlin), 4, 0.5),
+			Noise::Graph::ridged(Noise::Graph::source(perlin), 6, 0.45),
+			Noise::Graph::billow(Noise::Graph::source(perlin), 3, 0.5),
+			0.55, 0.05);
+
+		// Multiples of 1/64, so shifting them by 256 is exact
+		const int count = 4099;
+		std::vector<double> x(count), y(count), z(count);
+		for (int i = 0; i < count; i++)
+		{
+			x[i] = (i % 61) * 0.140625 - 4.0;
+			y[i] = (i / 61 % 67) * 0.203125 - 6.0;
+			z[i] = (i / 61) * 0.015625 - 0.5;
+		}
+		std::vector<float> xf(x.begin(), x.end()), yf(y.begin(), y.end()),
+			zf(z.begin(), z.end());
+
+		long long mismatches = 0;
+		auto report = [&](const char *check, int i, double got,
+			double expected)
+		{
+			if (mismatches++ < 10)
+				std::fprintf(
+					stderr, "graph %s: point %d got %.9g expected %.9g\n",
+					check, i, got, expected);
+		};
+
+		for (int octaves : { 1, 4, 8 })
+		{
+			auto fbm = Noise::Graph::fbm(
+				Noise::Graph::source(perlin), octaves, 0.5);
+			for (int i = 0; i < count; i++)
+			{
+				double px = std::abs(x[i]), py = std::abs(y[i]);
+				double got = fbm(px, py, z[i] + 1.0);
+				double expected = perlin.octave_noise(
+					px, py, z[i] + 1.0, octaves, 0.5);
+				if (got != expected)
+					report("fbm", i, got, expected);
+			}
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			double got = ridges(x[i], y[i], z[i]);
+			double expected =
+				ridges(x[i] + 256.0, y[i] + 256.0, z[i] + 256.0);
+			if (got != expected)
+				report("wrap", i, got, expected);
+
+			// Unwrapped Perlin noise reaches 1e10 and more here
+			double value = terrain(x[i], y[i], z[i]);
+			if (!(value >= -1.0 && value <= 2.0))
+				report("range", i, value, 0.5);
+		}
+
+		std::vector<unsigned char> mask(count);
+		for (double threshold : { 0.3, 0.5, 0.7 })
+		{
+			recipe.octave_threshold_batch(
+				x.data(), y.data(), z.data(), mask.data(), count, 3, 0.5,
+				threshold);
+			for (int i = 0; i < count; i++)
+			{
+				double noise = recipe.octave_noise(x[i], y[i], z[i], 3, 0.5);
+				if (mask[i] != (noise > threshold))
+					report("threshold double", i, mask[i], noise);
+			}
+
+			recipe.octave_threshold_batch(
+				xf.data(), yf.data(), zf.data(), mask.data(), count, 3,
+				0.5f, threshold);
+			auto fbm = Noise::Graph::fbm(terrain, 3, 0.5);
+			for (int i = 0; i < count; i++)
+			{
+				float noise = fbm(xf[i], yf[i], zf[i]);
+				if (mask[i] != (noise > threshold))
+					report("threshold float", i, mask[i], noise);
+			}
+		}
+		return mismatches;
+	}
+
+	/// Checks that a Noise::DynamicVolume built from a cached
+	/// Noise::ChunkNoise density decides every voxel like thresholding
+	/// Perlin's octave_noise at the chunk's coordinates, including a
+	/// chunk at negative coordinates.
+	/// \return Amount of mismatching voxels.
+	long long
+	verify_chunk_volume()
+	{
+		Noise::Perlin perlin;
+		Noise::ChunkNoiseSettings settings;
+		Noise::ChunkCache cache(16 << 20);
+		Noise::ChunkNoise<Noise::Perlin> noise(perlin, settings, cache);
+		const int size = settings.size;
+		const double threshold = 0.55;
+
+		long long mismatches = 0;
+		for (int cx : { -1, 3 })
+		{
+			Noise::DynamicVolume volume(Noise::ChunkDensitySlices(
+				noise.density(cx, 0, -2), size, threshold));
+			auto coordinate = [&](int chunk, int i)
+			{
+				return Noise::wrap_coordinate(
+					((double)chunk * size + i) * settings.scale);
+			};
+
+			for (int z = 0; z < size; z++)
+			for (int y = 0; y < size; y++)
+			for (int x = 0; x < size; x++)
+			{
+				double value = perlin.octave_noise(
+					coordinate(cx, x), coordinate(0, y),
+					coordinate(-2, z), settings.octaves,
+					settings.persistence);
+				if (volume.sample(x, y, z) == (value > threshold))
+					continue;
+				if (mismatches++ < 10)
+					std::fprintf(
+						stderr,
+						"chunk volume %d: voxel (%d, %d, %d) noise %.17g\n",
+						cx, x, y, z, value);
+			}
+		}
+		return mismatches;
+	}
+
+	/// A quad of a voxel mesh decoded from its vertices: side,
+	/// material, lowest and highest corner in voxel corner coordinates,
+	/// and the winding of its two triangles, 1 where they wind counter
+	/// clockwise around the side's normal. face_verts doesn't wind every
+	/// side the same way, so windings are compared rather than required.
+	using DecodedQuad = std::array<int, 10>;
+
+	/// Decodes the quads of a GFX::VoxelMesh with 1-unit voxels, sorted.
+	/// Float vertices carry no material, so it reads as 0 for them.
+	std::vector<DecodedQuad>
+	decode_quads(const GFX::Mesh &mesh, GFX::VertexFormat format)
+	{
+		const float *verts = mesh.vertex_data();
+		const unsigned int *indices = mesh.index_data();
+		const int stride = mesh.vertex_stride();
+
+		// Side, material and corner of a vertex
+		auto decode = [&](unsigned int v, int corner[3], int &side,
+			int &material)
+		{
+			const float *vert = verts + (size_t)v * stride;
+			if (format == GFX::VertexFormat::Float)
+			{
+				for (int axis = 0; axis < 3; axis++)
+					corner[axis] = (int)std::lround(vert[axis] + 0.5f);
+				const float *n = vert + 3;
+				side = (n[2] < 0) ? (int)GFX::Side::Back
+					: (n[2] > 0) ? (int)GFX::Side::Front
+					: (n[0] < 0) ? (int)GFX::Side::Left
+					: (n[0] > 0) ? (int)GFX::Side::Right
+					: (n[1] < 0) ? (int)GFX::Side::Bottom
+					: (int)GFX::Side::Top;
+				material = 0;
+				return;
+			}
+
+			uint32_t word[2] = { 0, 0 };
+			std::memcpy(
+				word, vert,
+				(format == GFX::VertexFormat::Packed64 ? 2 : 1)
+					* sizeof(uint32_t));
+			side = word[0] & 7;
+			material = (word[0] >> 3 & 0x7ff) | (word[1] >> 12 & 31) << 11;
+			for (int axis = 0; axis < 3; axis++)
+				corner[axis] = (word[0] >> (14 + 6 * axis) & 63)
+					| (word[1] >> (4 * axis) & 15) << 6;
+		};
+
+		std::vector<DecodedQuad> quads;
+		for (int i = 0; i + 6 <= mesh.indices_count(); i += 6)
+		{
+			DecodedQuad quad;
+			int corners[6][3];
+			for (int k = 0; k < 6; k++)
+				decode(indices[i + k], corners[k], quad[0], quad[1]);
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				quad[2 + axis] = quad[5 + axis] = corners[0][axis];
+				for (int k = 1; k < 6; k++)
+				{
+					quad[2 + axis] =
+						std::min(quad[2 + axis], corners[k][axis]);
+					quad[5 + axis] =
+						std::max(quad[5 + axis], corners[k][axis]);
+				}
+			}
+
+			// Normal axis and direction of the side, see GFX::Side
+			const int normal_axis = (quad[0] <= 1) ? 2
+				: (quad[0] <= 3) ? 0 : 1;
+			const int direction = (quad[0] % 2) ? 1 : -1;
+			for (int t = 0; t < 2; t++)
+			{
+				const int *a = corners[3 * t];
+				const int *b = corners[3 * t + 1];
+				const int *c = corners[3 * t + 2];
+				int u[3], v[3];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					u[axis] = b[axis] - a[axis];
+					v[axis] = c[axis] - a[axis];
+				}
+				int cross[3] = {
+					u[1] * v[2] - u[2] * v[1],
+					u[2] * v[0] - u[0] * v[2],
+					u[0] * v[1] - u[1] * v[0] };
+				quad[8 + t] = cross[normal_axis] * direction > 0;
+			}
+			quads.push_back(quad);
+		}
+		std::sort(quads.begin(), quads.end());
+		return quads;
+	}
+
+	/// Checks that GFX::StreamedVolumeMesh produces the same quads as
+	/// GFX::VolumeMesh over the same voxels, decoded from their vertices,
+	/// in every meshing mode and vertex format. Culled meshes are also
+	/// split across slabs, which greedy meshes only match in a single
+	/// slab.
+	/// \return Amount of mismatching meshes.
+	long long
+	verify_streamed_mesh()
+	{
+		const int size = 40;
+		Noise::Perlin perlin;
+		Noise::VolumeSlices<Noise::Perlin> slices(
+			perlin, size, size, size, 4.0f, 6, 0.4, 0.6);
+		GFX::DynamicVolume volume(size, size, size);
+		std::vector<unsigned char> slice((size_t)size * size);
+		for (int z = 0; z < size; z++)
+		{
+			slices.slice(z, slice.data());
+			for (int y = 0; y < size; y++)
+			for (int x = 0; x < size; x++)
+				if (slice[(size_t)y * size + x])
+					volume.voxel_at(x, y, z).material =
+						(uint16_t)GFX::VoxelMaterial::Stone;
+		}
+
+		long long mismatches = 0;
+		for (GFX::MeshingMode mode : {
+			GFX::MeshingMode::Culled, GFX::MeshingMode::Greedy })
+		for (GFX::VertexFormat format : {
+			GFX::VertexFormat::Float, GFX::VertexFormat::Packed32,
+			GFX::VertexFormat::Packed64 })
+		for (int threads : { 1, 3 })
+		{
+			if (mode == GFX::MeshingMode::Greedy && threads > 1)
+				continue;
+			GFX::VolumeMesh<GFX::DynamicVolume> expected(
+				volume, 1.0f, mode, format);
+			GFX::StreamedVolumeMesh<Noise::VolumeSlices<Noise::Perlin>>
+				streamed(slices, 1.0f, threads, mode, format);
+			std::vector<DecodedQuad> got = decode_quads(streamed, format);
+			std::vector<DecodedQuad> want = decode_quads(expected, format);
+			if (got == want
+				&& streamed.vertices_count() == expected.vertices_count())
+				continue;
+			mismatches++;
+			std::fprintf(
+				stderr,
+				"streamed mesh mode %d format %d threads %d: %zu quads "
+				"differ from %zu expected\n",
+				(int)mode, (int)format, threads, got.size(), want.size());
+		}
+		return mismatches;
+	}
+
+	/// Runs verify_thresholds on every generator with a thresholding
+	/// shortcut and verify_batch on the generators with their own
+	/// batched paths, in both buffer precisions, then verify_graph,
+	/// verify_chunk_volume and verify_streamed_mesh.
+	/// \return Whether all of them matched.
+	bool
+	verify()
+	{
+		long long mismatches = 0;
+		mismatches += verify_thresholds<double>("perlin", Noise::Perlin());
+		mismatches += verify_thresholds<float>("perlin", Noise::Perlin());
+		mismatches += verify_thresholds<double>("perlinf", Noise::PerlinF());
+		mismatches += verify_thresholds<float>("perlinf", Noise::PerlinF());
+		mismatches += verify_thresholds<double>("simplex", Noise::Simplex());
+		mismatches += verify_thresholds<float>("simplex", Noise::Simplex());
+		mismatches += verify_thresholds<double>(
+			"simplexf", Noise::SimplexF());
+		mismatches += verify_thresholds<float>(
+			"simplexf", Noise::SimplexF());
+		for (Noise::WorleyOutput output : {
+			Noise::WorleyOutput::F1, Noise::WorleyOutput::F2,
+			Noise::WorleyOutput::F2MinusF1 })
+		{
+			mismatches += verify_batch<double>(
+				"worley", Noise::Worley(output));
+			mismatches += verify_batch<float>(
+				"worley", Noise::Worley(output));
+			mismatches += verify_batch<float>(
+				"worleyf", Noise::WorleyF(output));
+		}
+
+		mismatches += verify_graph();
+		mismatches += verify_chunk_volume();
+		mismatches += verify_streamed_mesh();
+
+		std::fprintf(stderr, "verify: %lld mismatches\n", mismatches);
+		return mismatches == 0;
+	}
+
+	/// Noise::Graph recipes against the hand-written Perlin code they
+	/// replicate, at 4 and 6 octaves: fBm over a Perlin source evaluated
+	/// inline per point, the same recipe batched through Graph::Recipe,
+	/// and Perlin's octave_noise_batch at the scalar level and at the
+	/// best supported one.
+	void
+	bench_graph(const Options &opts, std::vector<Result> &results)
+	{
+		const int count = opts.quick ? 1 << 16 : 1 << 20;
+		Points<double> pts(count);
+		std::vector<double> out(count);
+		Noise::Perlin perlin;
+		auto recipe = Noise::Graph::recipe(Noise::Graph::source(perlin));
+
+		for (int octaves : { 4, 6 })
+		{
+			auto fbm = Noise::Graph::fbm(
+				Noise::Graph::source(perlin), octaves, 0.5);
+			results.push_back(measure(
+				"graph",
+				{ { "path", str("fbm") }, { "octaves", str(octaves) } },
+				count, opts.repeats, [&]
+				{
+					for (int i = 0; i < count; i++)
+						out[i] = fbm(pts.x[i], pts.y[i], pts.z[i]);
+					sink = out[count - 1];
+				}));
+			results.push_back(measure(
+				"graph",
+				{ { "path", str("recipe_batch") },
+					{ "octaves", str(octaves) } },
+				count, opts.repeats, [&]
+				{
+					recipe.octave_noise_batch(
+						pts.x.data(), pts.y.data(), pts.z.data(),
+						out.data(), count, octaves, 0.5);
+					sink = out[count - 1];
+				}));
+
+			for (Noise::SimdLevel level :
+				{ Noise::SimdLevel::Scalar, Noise::supported_simd_level() })
+			{
+				Noise::set_simd_level(level);
+				results.push_back(measure(
+					"graph",
+					{ { "path", str("perlin_batch") },
+						{ "simd", str(Noise::to_string(level)) },
+						{ "octaves", str(octaves) } },
+					count, opts.repeats, [&]
+					{
+						perlin.octave_noise_batch(
+							pts.x.data(), pts.y.data(), pts.z.data(),
+							out.data(), count, octaves, 0.5);
+						sink = out[count - 1];
+					}));
+			}
+			Noise::set_simd_level(Noise::supported_simd_level());
+		}
+	}
+
+	/// Noise::Image construction across sizes, octaves and threads.
+	void
+	bench_images(const Options &opts, std::vector<Result> &results)
+	{
+		Noise::Perlin perlin;
+		std::vector<int> sizes = opts.quick
+			? std::vector<int>{ 256 } : std::vector<int>{ 256, 1024 };
+
+		for (int size : sizes)
+		for (int octaves : { 1, 4, 8 })
+		for (int threads : thread_counts())
+		{
+			results.push_back(measure(
+				"image",
+				{ { "size", str(size) }, { "octaves", str(octaves) },
+					{ "threads", str(threads) } },
+				(long long)size * size, opts.repeats, [&]
+				{
+					Noise::Image image(
+						perlin, size, size, layout_r, 5.0f, octaves, 0.5,
+						Noise::Precision::Double, threads);
+					sink = image.data[0];
+				}));
+		}
+	}
+
+	/// Noise::DynamicVolume construction across sizes, octaves, threads,
+	/// precisions and with or without the coarse lattice.
+	void
+	bench_volumes(const Options &opts, std::vector<Result> &results)
+	{
+		Noise::Perlin perlin;
+		std::vector<int> sizes = opts.quick
+			? std::vector<int>{ 24, 64 } : std::vector<int>{ 24, 64, 128 };
+		Noise::CoarseOctaves coarse;
+		coarse.step = 4;
+
+		for (int size : sizes)
+		for (int octaves : { 1, 4, 8 })
+		for (int threads : thread_counts())
+		for (Noise::Precision precision :
+			{ Noise::Precision::Double, Noise::Precision::Float })
+		for (bool use_coarse : { false, true })
+		{
+			results.push_back(measure(
+				"volume",
+				{ { "size", str(size) }, { "octaves", str(octaves) },
+					{ "threads", str(threads) },
+					{ "precision", str(to_string(precision)) },
+					{ "coarse", str(use_coarse ? coarse.step : 1) } },
+				(long long)size * size * size, opts.repeats, [&]
+				{
+					Noise::DynamicVolume volume(
+						perlin, size, size, size, 1.0f, octaves, 0.5, 0.5,
+						precision, threads,
+						use_coarse ? coarse : Noise::CoarseOctaves());
+					sink = volume.sample(0, 0, 0);
+				}));
+		}
+	}
+
+	/// Noise::DynamicVolume construction as a heightfield with 3D noise
+	/// in a band around the surface, see Noise::Heightfield.
+	void
+	bench_heightfield_volumes(
+		const Options &opts, std::vector<Result> &results)
+	{
+		Noise::Perlin perlin;
+		std::vector<int> sizes = opts.quick
+			? std::vector<int>{ 64 } : std::vector<int>{ 64, 128 };
+
+		for (int size : sizes)
+		for (int band : { 0, 4, 8 })
+		{
+			Noise::Heightfield heightfield;
+			heightfield.band = band;
+			results.push_back(measure(
+				"volume.heightfield",
+				{ { "size", str(size) }, { "octaves", str(6) },
+					{ "band", str(band) } },
+				(long long)size * size * size, opts.repeats, [&]
+				{
+					Noise::DynamicVolume volume(
+						perlin, size, size, size, 4.0f, 6, 0.5, 0.5,
+						Noise::Precision::Double, 1,
+						Noise::CoarseOctaves(), heightfield);
+					sink = volume.sample(0, 0, 0);
+				}));
+		}
+	}
+
+	/// Noise::erode over Perlin heightfields across sizes and threads.
+	/// 4096 squared takes seconds per run, so it runs once and only
+	/// outside of quick mode.
+	void
+	bench_erosion(const Options &opts, std::vector<Result> &results)
+	{
+		Noise::Perlin perlin;
+		std::vector<int> sizes = opts.quick
+			? std::vector<int>{ 1024 } : std::vector<int>{ 1024, 4096 };
+		Noise::Erosion erosion;
+		erosion.iterations = 16;
+
+		for (int size : sizes)
+		{
+			Noise::Image image(
+				perlin, size, size, layout_r, 4.0f, 6, 0.5,
+				Noise::Precision::Float, 0);
+			std::vector<float> heights((size_t)size * size);
+			for (size_t i = 0; i < heights.size(); i++)
+				heights[i] = image.data[i] / 255.0f * erosion.relief * size;
+
+			for (int threads : thread_counts())
+			{
+				results.push_back(measure(
+					"erosion",
+					{ { "size", str(size) },
+						{ "iterations", str(erosion.iterations) },
+						{ "threads", str(threads) } },
+					(long long)size * size * erosion.iterations,
+					(size > 1024) ? 1 : opts.repeats, [&]
+					{
+						std::vector<float> eroded = heights;
+						Noise::erode(
+							eroded.data(), size, size, erosion, threads);
+						sink = eroded[0];
+					}));
+			}
+		}
+	}
+
+	/// Noise::BiomeMap climates of a square of columns, with the tiles
+	/// generated on the way and with all of them cached.
+	void
+	bench_biomes(const Options &opts, std::vector<Result> &results)
+	{
+		int size = opts.quick ? 256 : 1024;
+		std::vector<Noise::Climate> climates((size_t)size * size);
+
+		for (bool cached : { false, true })
+		{
+			Noise::BiomeMap map;
+			results.push_back(measure(
+				"biome.climate",
+				{ { "size", str(size) }, { "cached", str(cached) } },
+				(long long)size * size, opts.repeats, [&]
+				{
+					if (!cached)
+						map.clear();
+					map.climate_rect(0, 0, size, size, climates.data());
+					sink = climates[0].temperature;
+				}));
+		}
+	}
+
+	/// Noise::BakedNoise baking, and its sampling against the 4 octave
+	/// Perlin batches it stands in for.
+	void
+	bench_baked(const Options &opts, std::vector<Result> &results)
+	{
+		std::vector<int> sizes = opts.quick
+			? std::vector<int>{ 32 } : std::vector<int>{ 32, 64, 128 };
+		for (int size : sizes)
+		for (int threads : thread_counts())
+		{
+			results.push_back(measure(
+				"baked.bake",
+				{ { "size", str(size) }, { "octaves", str(4) },
+					{ "threads", str(threads) } },
+				(long long)size * size * size, opts.repeats, [&]
+				{
+					Noise::BakedNoise baked(size, 4, 4, 0.5, 0, threads);
+					sink = baked.data()[0];
+				}));
+		}
+
+		const int count = opts.quick ? 1 << 16 : 1 << 20;
+		Points<float> points(count);
+		std::vector<float> out(count);
+		Noise::BakedNoise baked(64, 4, 4, 0.5);
+		results.push_back(measure(
+			"baked.sample_batch", { { "size", str(64) } }, count,
+			opts.repeats, [&]
+			{
+				baked.sample_batch(
+					points.x.data(), points.y.data(), points.z.data(),
+					out.data(), count);
+				sink = out[count - 1];
+			}));
+	}
+
+	/// Noise::ChunkNoise densities of a square of chunks, evaluated with
+	/// an empty cache and served from a warm one, as when the camera
+	/// returns to chunks it has seen.
+	void
+	bench_chunk_cache(const Options &opts, std::vector<Result> &results)
+	{
+		Noise::Perlin perlin;
+		Noise::ChunkNoiseSettings settings;
+		int chunks = opts.quick ? 4 : 8;
+		long long voxels = (long long)chunks * chunks
+			* settings.size * settings.size * settings.size;
+
+		for (bool warm : { false, true })
+		{
+			Noise::ChunkCache cache(256 << 20);
+			Noise::ChunkNoise<Noise::Perlin> noise(perlin, settings, cache);
+			results.push_back(measure(
+				"chunk_cache.density",
+				{ { "chunks", str(chunks * chunks) },
+					{ "size", str(settings.size) }, { "warm", str(warm) } },
+				voxels, opts.repeats, [&]
+				{
+					if (!warm)
+						cache.clear();
+					for (int z = 0; z < chunks; z++)
+					for (int x = 0; x < chunks; x++)
+						sink = (*noise.density(x, 0, z))[0];
+				}));
+		}
+	}
+
+	/// GFX::VolumeMesh generation over a GFX::DynamicVolume holding the
+	/// voxels of a noise volume. Only builds the vertices, so needs no GL
+	/// context.
+	void
+	bench_meshing(const Options &opts, std::vector<Result> &results)
+	{
+		Noise::Perlin perlin;
+		std::vector<int> sizes = opts.quick
+			? std::vector<int>{ 24 } : std::vector<int>{ 24, 64 };
+		for (int size : sizes)
+		{
+			Noise::DynamicVolume noise(
+				perlin, size, size, size, 4.0f, 6, 0.4, 0.6);
+			GFX::DynamicVolume volume(size, size, size);
+			for (int z = 0; z < size; z++)
+			for (int y = 0; y < size; y++)
+			for (int x = 0; x < size; x++)
+				if (noise.sample(x, y, z))
+					volume.voxel_at(x, y, z).material =
+						(uint16_t)GFX::VoxelMaterial::Stone;
+
+			for (bool greedy : { false, true })
+			{
+				GFX::MeshingMode mode = greedy
+					? GFX::MeshingMode::Greedy : GFX::MeshingMode::Culled;
+				results.push_back(measure(
+					"volume.mesh",
+					{ { "size", str(size) },
+						{ "voxel_bytes", str((int)sizeof(GFX::Voxel)) },
+						{ "greedy", str(greedy) } },
+					(long long)size * size * size, opts.repeats, [&]
+					{
+						GFX::VolumeMesh<GFX::DynamicVolume> mesh(
+							volume, 1.0f, mode);
+						sink = mesh.vertices_count();
+					}));
+			}
+		}
+	}
+
+	void
+	write_json(
+		std::FILE *file, const Options &opts,
+		const std::vector<Result> &results)
+	{
+		std::fprintf(file, "{\n");
+		std::fprintf(file, "  \"benchmark\": \"landscape_bench\",\n");
+		std::fprintf(
+			file, "  \"quick\": %s,\n", opts.quick ? "true" : "false");
+		std::fprintf(file, "  \"repeats\": %d,\n", opts.repeats);
+		std::fprintf(
+			file, "  \"hardware_threads\": %d,\n",
+			Parallel::hardware_threads());
+		std::fprintf(
+			file, "  \"simd\": \"%s\",\n",
+			Noise::to_string(Noise::supported_simd_level()));
+		std::fprintf(file, "  \"results\": [\n");
+
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result &r = results[i];
+			std::fprintf(
+				file, "    { \"name\": \"%s\", \"params\": {",
+				r.name.c_str());
+			for (size_t p = 0; p < r.params.size(); p++)
+				std::fprintf(
+					file, "%s \"%s\": %s", p ? "," : "",
+					r.params[p].first.c_str(), r.params[p].second.c_str());
+			std::fprintf(
+				file,
+				" }, \"samples\": %lld, \"min_ms\": %.4f, "
+				"\"median_ms\": %.4f, \"ns_per_sample\": %.3f }%s\n",
+				r.samples, r.min_ms, r.median_ms,
+				r.median_ms * 1e6 / (double)r.samples,
+				(i + 1 < results.size()) ? "," : "");
+		}
+
+		std::fprintf(file, "  ]\n}\n");
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	Options opts;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!std::strcmp(argv[i], "--quick"))
+			opts.quick = true;
+		else if (!std::strcmp(argv[i], "--repeats") && i + 1 < argc)
+			opts.repeats = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--out") && i + 1 < argc)
+			opts.out = argv[++i];
+		else if (!std::strcmp(argv[i], "--verify"))
+			opts.verify = true;
+		else
+		{
+			std::fprintf(
+				stderr,
+				"usage: %s [--quick] [--repeats N] [--out FILE] "
+				"[--verify]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (opts.verify)
+		return verify() ? 0 : 1;
+	if (!opts.repeats)
+		opts.repeats = opts.quick ? 2 : 5;
+
+	std::vector<Result> results;
+	bench_point_calls(opts, results);
+	bench_batches<double>(opts, "perlin", Noise::Perlin(), true,
+		results);
+	bench_batches<float>(opts, "perlin", Noise::PerlinF(), true,
+		results);
+	bench_batches<double>(opts, "simplex", Noise::Simplex(), false,
+		results);
+	bench_batches<float>(opts, "simplex", Noise::SimplexF(), false,
+		results);
+	bench_batches<double>(opts, "worley", Noise::Worley(), true,
+		results);
+	bench_batches<float>(opts, "worley", Noise::WorleyF(), true,
+		results);
+	bench_graph(opts, results);
+	bench_images(opts, results);
+	bench_volumes(opts, results);
+	bench_heightfield_volumes(opts, results);
+	bench_erosion(opts, results);
+	bench_biomes(opts, results);
+	bench_baked(opts, results);
+	bench_chunk_cache(opts, results);
+	bench_meshing(opts, results);
+
+	std::FILE *file = opts.out ? std::fopen(opts.out, "w") : stdout;
+	if (!file)
+	{
+		std::fprintf(stderr, "Could not open %s\n", opts.out);
+		return 1;
+	}
+	write_json(file, opts, results);
+	if (file != stdout)
+		std::fclose(file);
+	return 0;
+}
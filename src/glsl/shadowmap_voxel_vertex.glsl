@@ -0,0 +1,16 @@
+#version 330 core
+
+// Voxel vertices packed by GFX::VoxelMesh, see glsl/voxel_vertex.glsl
+layout (location = 0) in uvec2 aPacked;
+
+uniform mat4 light_space_matrix;
+uniform mat4 model;
+uniform float voxel_size = 1.0;
+
+void main() {
+	uvec3 low = uvec3(aPacked.x >> 14u, aPacked.x >> 20u, aPacked.x >> 26u);
+	uvec3 high = uvec3(aPacked.y, aPacked.y >> 4u, aPacked.y >> 8u);
+	vec3 corner = vec3((low & 63u) | ((high & 15u) << 6u));
+	vec3 pos = (corner - 0.5) * voxel_size;
+	gl_Position = light_space_matrix * model * vec4(pos, 1.0);
+}
@@ -0,0 +1,44 @@
+#version 330 core
+
+// Voxel vertices packed by GFX::VoxelMesh, see GFX::VertexFormat. Packed32
+// vertices only have the first word, so the second one reads as 0.
+layout (location = 0) in uvec2 aPacked;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 light_space_matrix;
+uniform float voxel_size = 1.0;
+
+out vec3 normal;
+out vec2 tex_coords;
+out vec3 frag_pos;
+out vec4 frag_pos_light_space;
+
+// Indexed by GFX::Side
+const vec3 normals[6] = vec3[6](
+	vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0),
+	vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+	vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0));
+
+void main()
+{
+	uint side = aPacked.x & 7u;
+	uvec3 low = uvec3(aPacked.x >> 14u, aPacked.x >> 20u, aPacked.x >> 26u);
+	uvec3 high = uvec3(aPacked.y, aPacked.y >> 4u, aPacked.y >> 8u);
+	vec3 corner = vec3((low & 63u) | ((high & 15u) << 6u));
+	vec3 pos = (corner - 0.5) * voxel_size;
+
+	// Same orientation as GFX::face_verts, repeating once per voxel
+	if (side < 2u)
+		tex_coords = vec2(corner.x, corner.y);
+	else if (side < 4u)
+		tex_coords = vec2(corner.y, -corner.z);
+	else
+		tex_coords = vec2(corner.x, -corner.z);
+
+	normal = transpose(inverse(mat3(model))) * normals[side];
+	frag_pos = vec3(model * vec4(pos, 1.0));
+	frag_pos_light_space = light_space_matrix * vec4(frag_pos, 1.0);
+	gl_Position = projection * view * model * vec4(pos, 1.0);
+}
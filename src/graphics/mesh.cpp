@@ -1,4 +1,6 @@
 #include <stdlib.h>
+#include <stdint.h>
+#include <vector>
 #include <graphics/mesh.h>
 #include <glad/glad.h>
 
@@ -18,6 +20,8 @@ Mesh::~Mesh()
 		glDeleteVertexArrays(1, &vao);
 		glDeleteBuffers(1, &vbo);
 	}
+	if (ebo != UINT_MAX)
+		glDeleteBuffers(1, &ebo);
 }
 
 void Mesh::set(float *verts, int verts_count, int vert_stride)
@@ -27,6 +31,13 @@ void Mesh::set(float *verts, int verts_count, int vert_stride)
 	this->vert_stride = vert_stride;
 }
 
+void
+Mesh::set_indices(unsigned int *indices, int indices_count)
+{
+	this->indices = indices;
+	this->idx_count = indices_count;
+}
+
 void
 Mesh::load()
 {
@@ -39,6 +50,24 @@ Mesh::load()
 		sizeof(float) * verts_count * vert_stride,
 		verts,
 		GL_STATIC_DRAW);
+
+	// The element buffer binding is part of the vertex array state
+	if (indices)
+	{
+		glGenBuffers(1, &ebo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		if (index_size() == sizeof(uint16_t))
+		{
+			std::vector<uint16_t> narrow(indices, indices + idx_count);
+			glBufferData(
+				GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * idx_count,
+				narrow.data(), GL_STATIC_DRAW);
+		}
+		else
+			glBufferData(
+				GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * idx_count,
+				indices, GL_STATIC_DRAW);
+	}
 	glBindVertexArray(0);
 }
 
@@ -53,6 +82,16 @@ Mesh::add_vertex_attrib_array(int index, int size, void *offset)
 	glBindVertexArray(0);
 }
 
+void
+Mesh::add_vertex_attrib_uint_array(int index, int size, void *offset)
+{
+	glBindVertexArray(vao);
+	glEnableVertexAttribArray(index);
+	glVertexAttribIPointer(
+		index, size, GL_UNSIGNED_INT, sizeof(float) * vert_stride, offset);
+	glBindVertexArray(0);
+}
+
 void
 Mesh::use() const
 {
@@ -61,5 +100,49 @@ Mesh::use() const
 
 void Mesh::draw() const
 {
-	glDrawArrays(GL_TRIANGLES, 0, verts_count);
+	if (indices)
+		glDrawElements(
+			GL_TRIANGLES, idx_count,
+			(index_size() == sizeof(uint16_t))
+				? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+			nullptr);
+	else
+		glDrawArrays(GL_TRIANGLES, 0, verts_count);
+}
+
+int
+Mesh::vertices_count() const
+{
+	return verts_count;
+}
+
+int
+Mesh::indices_count() const
+{
+	return idx_count;
+}
+
+const float *
+Mesh::vertex_data() const
+{
+	return verts;
+}
+
+int
+Mesh::vertex_stride() const
+{
+	return vert_stride;
+}
+
+const unsigned int *
+Mesh::index_data() const
+{
+	return indices;
+}
+
+int
+Mesh::index_size() const
+{
+	return (verts_count <= UINT16_MAX + 1)
+		? sizeof(uint16_t) : sizeof(uint32_t);
 }
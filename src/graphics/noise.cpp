@@ -1,13 +1,137 @@
 #include <iostream>
 #include <cmath>
 #include <cstdint>
+#include <array>
+#include <random>
+#include <algorithm>
 #include <graphics/noise.h>
 
+// Noise::OctavedGenerator
+
+void
+Noise::OctavedGenerator::octave_noise_batch(
+	const double *x, const double *y, const double *z, double *out,
+	int count, int octaves, double persistence
+) const {
+	for (int i = 0; i < count; i++)
+		out[i] = octave_noise(x[i], y[i], z[i], octaves, persistence);
+}
+
+void
+Noise::OctavedGenerator::octave_noise_batch(
+	const float *x, const float *y, const float *z, float *out,
+	int count, int octaves, float persistence
+) const {
+	for (int i = 0; i < count; i++)
+		out[i] = (float)octave_noise(x[i], y[i], z[i], octaves, persistence);
+}
+
+/// Thresholds octave_noise_batch output in blocks on the stack.
+template <typename Real>
+static void
+threshold_blocks(
+	const Noise::OctavedGenerator &gen, const Real *x, const Real *y,
+	const Real *z, unsigned char *out, int count, int octaves,
+	Real persistence, double threshold
+) {
+	const int block = 256;
+	std::array<Real, block> noise;
+	for (int start = 0; start < count; start += block)
+	{
+		int n = std::min(block, count - start);
+		gen.octave_noise_batch(
+			x + start, y + start, z + start, noise.data(), n, octaves,
+			persistence);
+		for (int i = 0; i < n; i++)
+			out[start + i] = (noise[i] > threshold)
+				? (unsigned char)0x1
+				: (unsigned char)0x0;
+	}
+}
+
+void
+Noise::OctavedGenerator::octave_threshold_batch(
+	const double *x, const double *y, const double *z, unsigned char *out,
+	int count, int octaves, double persistence, double threshold
+) const {
+	threshold_blocks(
+		*this, x, y, z, out, count, octaves, persistence, threshold);
+}
+
+void
+Noise::OctavedGenerator::octave_threshold_batch(
+	const float *x, const float *y, const float *z, unsigned char *out,
+	int count, int octaves, float persistence, double threshold
+) const {
+	threshold_blocks(
+		*this, x, y, z, out, count, octaves, persistence, threshold);
+}
+
+double
+Noise::OctavedGenerator::octave_curvature() const
+{
+	return 20.0;
+}
+
+int
+Noise::OctavedGenerator::threshold_octaves(
+	int octaves, double persistence, double threshold
+) const {
+	return octaves;
+}
+
+// Noise::CoarseOctaves
+
+int
+Noise::CoarseOctaves::octaves_for(
+	const OctavedGenerator &gen, double spacing_x, double spacing_y,
+	double spacing_z, int total_octaves, double persistence,
+	double threshold
+) const {
+	if (step <= 1)
+		return 0;
+	if (octaves >= 0)
+		return std::min(octaves, total_octaves);
+	
+	double amplitude_sum = 0;
+	double amplitude = 1;
+	for (int i = 0; i < total_octaves; i++)
+	{
+		amplitude_sum += std::abs(amplitude);
+		amplitude *= persistence;
+	}
+	
+	// Squared lattice spacing summed over the axes
+	double h2 = (double)step * step * (
+		spacing_x * spacing_x + spacing_y * spacing_y
+		+ spacing_z * spacing_z);
+	
+	double error = 0;
+	double scale = 1;
+	amplitude = 1;
+	int low = 0;
+	for (; low < total_octaves; low++)
+	{
+		error += std::abs(amplitude) / amplitude_sum
+			* h2 * scale / 8 * gen.octave_curvature();
+		if (error > max_error)
+			break;
+		
+		amplitude *= persistence;
+		scale *= 4;
+	}
+	
+	if (total_octaves - low
+		> gen.threshold_octaves(total_octaves, persistence, threshold))
+		return 0;
+	return low;
+}
+
 // Noise::Perlin
 
 /// Hash lookup table as defined by Ken Perlin. This is a randomly arranged array
 /// of all numbers from 0-255 inclusive.
-int perms[] = {
+static constexpr int perms_ref[] = {
 	151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,
 	140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148, 247,
 	120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32, 57,
@@ -27,257 +151,134 @@ int perms[] = {
 	78, 66, 215, 61, 156, 180
 };
 
-Noise::Perlin::Perlin(int repeat): repeat(repeat) {}
-
-double
-Noise::Perlin::noise(double x, double y, double z) const
+std::array<int, 512>
+Noise::permutation_table(unsigned int seed)
 {
-	if (repeat)
-	{
-		// Does input really have to be a double?
-		x = (int)x % repeat;
-		y = (int)y % repeat;
-		z = (int)z % repeat;
-	}
-	
-	// Calculate permutation table index for each coordinate
-	int xi = (int)x & 255;
-	int yi = (int)y & 255;
-	int zi = (int)z & 255;
-	
-	// Calculate remainders for each coordinate
-	double xf = x - (int)x;
-	double yf = y - (int)y;
-	double zf = z - (int)z;
+	std::array<int, 512> table;
+	std::copy_n(perms_ref, 256, table.begin());
 	
-	// Ease coordinate values
-	double u = fade(xf);
-	double v = fade(yf);
-	double w = fade(zf);
-	
-	// Perlin noise hash function using the permutation table
-	int aaa, aba, aab, abb, baa, bba, bab, bbb;
-	aaa = perms[perms[perms[    xi ]+    yi ]+    zi ];
-	aba = perms[perms[perms[    xi ]+inc(yi)]+    zi ];
-	aab = perms[perms[perms[    xi ]+    yi ]+inc(zi)];
-	abb = perms[perms[perms[    xi ]+inc(yi)]+inc(zi)];
-	baa = perms[perms[perms[inc(xi)]+    yi ]+    zi ];
-	bba = perms[perms[perms[inc(xi)]+inc(yi)]+    zi ];
-	bab = perms[perms[perms[inc(xi)]+    yi ]+inc(zi)];
-	bbb = perms[perms[perms[inc(xi)]+inc(yi)]+inc(zi)];
-	
-	// The gradient function calculates the dot product between a
-	// pseudorandom gradient vector and the vector from the input coordinate
-	// to the 8 surrounding points in its unit cube.
-	// This is all then lerped together as a sort of weighted average based
-	// on the faded (u, v, w) values we made earlier.
-	double x1, x2, y1, y2;
-	x1 = lerp(
-		grad(aaa, xf, yf, zf),
-		grad(baa, xf - 1, yf, zf),
-		u);
-	x2 = lerp(
-		grad(aba, xf, yf - 1, zf),
-		grad(bba, xf - 1, yf - 1, zf),
-		u);
-	y1 = lerp(x1, x2, v);
-	
-	x1 = lerp(
-		grad(aab, xf, yf, zf - 1),
-		grad(bab, xf - 1, yf, zf - 1),
-		u);
-	x2 = lerp(
-		grad(abb, xf, yf - 1, zf - 1),
-		grad(bbb, xf - 1, yf - 1, zf - 1),
-		u);
-	y2 = lerp(x1, x2, v);
-	
-	// For convenience we bind the result to [0, 1]
-	return (lerp(y1, y2, w) + 1) / 2;
-}
-
-double
-Noise::Perlin::octave_noise(
-	double x, double y, double z, int octaves, double persistence
-) const {
-	double total = 0;
-	double frequency = 1;
-	double amplitude = 1;
-	double max_val = 0;  // Used for normalizing result to 0.0 - 1.0
-	
-	for(int i = 0; i < octaves; i++) {
-		total += noise(x * frequency, y * frequency, z * frequency)
-			* amplitude;
-		
-		max_val += amplitude;
-		
-		amplitude *= persistence;
-		frequency *= 2;
+	// Fisher-Yates shuffle. The distribution is done by hand, since the
+	// standard library ones aren't guaranteed to match across platforms,
+	// while std::mt19937 output is. Draws past the last whole multiple of
+	// i + 1 are rejected, so every index is equally likely.
+	if (seed != 0)
+	{
+		std::mt19937 rng(seed);
+		for (uint32_t i = 255; i > 0; i--)
+		{
+			const uint32_t bound = i + 1;
+			const uint32_t limit = UINT32_MAX - UINT32_MAX % bound;
+			uint32_t r;
+			do
+				r = (uint32_t)rng();
+			while (r >= limit);
+			std::swap(table[i], table[r % bound]);
+		}
 	}
 	
-	return total / max_val;
+	std::copy_n(table.begin(), 256, table.begin() + 256);
+	return table;
 }
 
-/// Fade function easing coordinate values so they will ease towards
-/// integral values, ending up smoothing the final output.
-/// 6t^5 - 15t^4 + 10t^3
-double
-Noise::Perlin::fade(double t) const
-{
-	return t * t * t * (t * (t * 6 - 15) + 10);
-}
+// Noise::Image
 
-int
-Noise::Perlin::inc(int num) const
+bool
+Noise::Image::is_gray_layout_supported(ColorLayout layout)
 {
-	num++;
-	if (repeat > 0) num %= repeat;
-	return num;
+	switch (layout)
+	{
+		case layout_rgba:
+		case layout_rgb:
+		case layout_rg:
+		case layout_r:
+			return true;
+		case layout_depth16:
+		default:
+			std::cout
+				<< "Unsupported ColorLayout type "
+				<< std::hex << layout << "."
+				<< std::endl;
+			return false;
+	}
 }
 
-double
-Noise::Perlin::grad(int hash, double x, double y, double z) const
+/// Writes a row of noise values in the [0, 1] range as gray pixels in the
+/// requested layout. Unless its alpha, then just set it to 255. The layout
+/// is dispatched once per row rather than per pixel.
+template <typename Real>
+static void
+write_gray_pixels(
+	unsigned char *dst, const Real *noise, int width, ColorLayout layout)
 {
-	switch(hash & 0xF)
+	switch (layout)
 	{
-		case 0x0:
-			return  x + y;
-		case 0x1:
-			return -x + y;
-		case 0x2:
-			return  x - y;
-		case 0x3:
-			return -x - y;
-		case 0x4:
-			return  x + z;
-		case 0x5:
-			return -x + z;
-		case 0x6:
-			return  x - z;
-		case 0x7:
-			return -x - z;
-		case 0x8:
-			return  y + z;
-		case 0x9:
-			return -y + z;
-		case 0xA:
-			return  y - z;
-		case 0xB:
-			return -y - z;
-		case 0xC:
-			return  y + x;
-		case 0xD:
-			return -y + z;
-		case 0xE:
-			return  y - x;
-		case 0xF:
-			return -y - z;
+		case layout_rgba:
+			for (int ix = 0; ix < width; ix++, dst += 4)
+			{
+				uint8_t gray = (uint8_t)(255.0f * (double)noise[ix]);
+				dst[0] = gray;
+				dst[1] = gray;
+				dst[2] = gray;
+				dst[3] = (uint8_t)255;
+			}
+			break;
+		case layout_rgb:
+			for (int ix = 0; ix < width; ix++, dst += 3)
+			{
+				uint8_t gray = (uint8_t)(255.0f * (double)noise[ix]);
+				dst[0] = gray;
+				dst[1] = gray;
+				dst[2] = gray;
+			}
+			break;
+		case layout_rg:
+			for (int ix = 0; ix < width; ix++, dst += 2)
+			{
+				uint8_t gray = (uint8_t)(255.0f * (double)noise[ix]);
+				dst[0] = gray;
+				dst[1] = gray;
+			}
+			break;
+		case layout_r:
+			for (int ix = 0; ix < width; ix++)
+				dst[ix] = (uint8_t)(255.0f * (double)noise[ix]);
+			break;
 		default:
-			return 0; // Never happens
+			break;
 	}
 }
 
-double
-Noise::Perlin::lerp(double a, double b, double x) const
-{
-	return a + x * (b - a);
+void
+Noise::Image::write_gray_row(
+	unsigned char *dst, const double *noise, int width, ColorLayout layout
+) {
+	write_gray_pixels(dst, noise, width, layout);
 }
 
-// Noise::Image
+void
+Noise::Image::write_gray_row(
+	unsigned char *dst, const float *noise, int width, ColorLayout layout
+) {
+	write_gray_pixels(dst, noise, width, layout);
+}
 
 Noise::Image::Image(
 	Noise::Generator &generator, int width, int height, ColorLayout layout,
-	float frequency
+	float frequency, int threads
 ) : ::Image(nullptr, width, height, color_layout_byte_size(layout))
 {
-	int channels = color_layout_byte_size(layout);
-	
-	// Manually allocate the buffer.
-	data = new unsigned char[width * height * channels];
-	
-	// Iterate through each pixel.
-	for (int ix = 0; ix < width; ix++)
-		for (int iy = 0; iy < height; iy++)
-		{
-			// Convert the indices to [0, scale] range.
-			double x_noise = (frequency / width) * ix;
-			double y_noise = (frequency / height) * iy;
-			double noise = generator.noise(x_noise, y_noise, 1.0f);
-			
-			// Convert to a [0, 255] int.
-			int pixel_idx =
-				(ix * channels) + (iy * width * channels);
-			int gray = (uint8_t)(255.0f * noise);
-			
-			// Insert in required channels. Unless its alpha, then
-			// just set it to 255.
-			switch (layout)
-			{
-				case layout_rgba:
-					data[pixel_idx + 3] = (uint8_t)255;
-				case layout_rgb:
-					data[pixel_idx + 2] = (uint8_t)gray;
-				case layout_rg:
-					data[pixel_idx + 1] = (uint8_t)gray;
-				case layout_r:
-					data[pixel_idx] = (uint8_t)gray;
-					break;
-				case layout_depth16:
-				default:
-					std::cout
-					<< "Unsupported ColorLayout type "
-						<< std::hex << layout << "."
-						<< std::endl;
-			}
-		}
+	fill(generator, width, height, layout, frequency, threads);
 }
 
 Noise::Image::Image(
 	Noise::OctavedGenerator &generator, int width, int height,
-	ColorLayout layout, float frequency, int octaves, double persistence
+	ColorLayout layout, float frequency, int octaves, double persistence,
+	Precision precision, int threads
 ) : ::Image(nullptr, width, height, color_layout_byte_size(layout))
 {
-	int channels = color_layout_byte_size(layout);
-	
-	// Manually allocate the buffer.
-	data = new unsigned char[width * height * channels];
-	
-	// Iterate through each pixel.
-	for (int ix = 0; ix < width; ix++)
-		for (int iy = 0; iy < height; iy++)
-		{
-			// Convert the indices to [0, scale] range.
-			double xn = (frequency / width) * ix;
-			double yn = (frequency / height) * iy;
-			double noise = generator.octave_noise(
-				xn, yn, 1.0f, octaves, persistence);
-			int gray = (uint8_t)(255.0f * noise);
-			
-			// Convert to a [0, 255] int.
-			int pixel_idx =
-				(ix * channels) + (iy * width * channels);
-			
-			// Insert in required channels. Unless its alpha, then
-			// just set it to 255.
-			switch (layout)
-			{
-				case layout_rgba:
-					data[pixel_idx + 3] = (uint8_t)255;
-				case layout_rgb:
-					data[pixel_idx + 2] = (uint8_t)gray;
-				case layout_rg:
-					data[pixel_idx + 1] = (uint8_t)gray;
-				case layout_r:
-					data[pixel_idx] = (uint8_t)gray;
-					break;
-				case layout_depth16:
-				default:
-					std::cout
-					<< "Unsupported ColorLayout type "
-						<< std::hex << layout << "."
-						<< std::endl;
-			}
-		}
+	fill(
+		generator, width, height, layout, frequency, octaves, persistence,
+		precision, threads);
 }
 
 Noise::Image::~Image()
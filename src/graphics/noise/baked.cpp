@@ -0,0 +1,138 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <graphics/noise.h>
+#include <graphics/noise/baked.h>
+#include <parallel.h>
+
+namespace
+{
+	/// Start of a saved table, followed by size^3 floats.
+	struct Header
+	{
+		char magic[4];
+		int32_t size;
+		int32_t period;
+		int32_t octaves;
+		uint32_t seed;
+		double persistence;
+	};
+
+	/// Bumped whenever the saved values change for the same settings, such
+	/// as when seeded permutation tables did.
+	const char magic[4] = { 'L', 'B', 'N', '2' };
+}
+
+Noise::BakedNoise::BakedNoise(
+	int size, int period, int octaves, double persistence,
+	unsigned int seed, int threads
+) : BakedNoise(Unfilled(), size, period, octaves, persistence, seed)
+{
+	bake(threads);
+}
+
+Noise::BakedNoise::BakedNoise(
+	Unfilled, int size, int period, int octaves, double persistence,
+	unsigned int seed
+) : dim(size), repeat(period), octaves(octaves), persistence(persistence),
+	seed(seed), scale((float)size / period)
+{
+	if (size <= 0 || (size & (size - 1)))
+		throw std::invalid_argument("BakedNoise: size not a power of two");
+	if (period < 1 || period > 256)
+		throw std::invalid_argument("BakedNoise: period outside [1, 256]");
+
+	values = AlignedArray<float>((size_t)size * size * size);
+}
+
+Noise::BakedNoise
+Noise::BakedNoise::cached(
+	const char *path, int size, int period, int octaves,
+	double persistence, unsigned int seed, int threads
+) {
+	BakedNoise noise(Unfilled(), size, period, octaves, persistence, seed);
+	if (!noise.load(path))
+	{
+		noise.bake(threads);
+		noise.save(path);
+	}
+	return noise;
+}
+
+void
+Noise::BakedNoise::bake(int threads)
+{
+	Perlin perlin(repeat, seed);
+	double step = (double)repeat / dim;
+
+	Parallel::for_ranges(0, dim, threads, [&](int z_from, int z_to)
+	{
+		std::vector<double> xs(dim), ys(dim), zs(dim), out(dim);
+		for (int ix = 0; ix < dim; ix++)
+			xs[ix] = step * ix;
+
+		for (int iz = z_from; iz < z_to; iz++)
+		for (int iy = 0; iy < dim; iy++)
+		{
+			std::fill(ys.begin(), ys.end(), step * iy);
+			std::fill(zs.begin(), zs.end(), step * iz);
+			perlin.octave_noise_batch(
+				xs.data(), ys.data(), zs.data(), out.data(), dim, octaves,
+				persistence);
+
+			float *row = &values[((size_t)iz * dim + iy) * dim];
+			for (int ix = 0; ix < dim; ix++)
+				row[ix] = (float)out[ix];
+		}
+	});
+}
+
+bool
+Noise::BakedNoise::save(const char *path) const
+{
+	std::FILE *file = std::fopen(path, "wb");
+	if (!file)
+		return false;
+
+	Header header = {};
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.size = dim;
+	header.period = repeat;
+	header.octaves = octaves;
+	header.seed = seed;
+	header.persistence = persistence;
+
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+		&& std::fwrite(values.data(), sizeof(float), values.size(), file)
+			== values.size();
+	return (std::fclose(file) == 0) && written;
+}
+
+bool
+Noise::BakedNoise::load(const char *path)
+{
+	std::FILE *file = std::fopen(path, "rb");
+	if (!file)
+		return false;
+
+	Header header;
+	bool loaded = std::fread(&header, sizeof(header), 1, file) == 1
+		&& !std::memcmp(header.magic, magic, sizeof(magic))
+		&& header.size == dim && header.period == repeat
+		&& header.octaves == octaves && header.seed == seed
+		&& header.persistence == persistence
+		&& std::fread(values.data(), sizeof(float), values.size(), file)
+			== values.size();
+	std::fclose(file);
+	return loaded;
+}
+
+void
+Noise::BakedNoise::sample_batch(
+	const float *x, const float *y, const float *z, float *out, int count
+) const {
+	for (int i = 0; i < count; i++)
+		out[i] = sample(x[i], y[i], z[i]);
+}
@@ -0,0 +1,248 @@
+#include <stdexcept>
+#include <graphics/noise/biome.h>
+
+/// Rounds a / b towards negative infinity, for b > 0.
+static int
+floor_div(int a, int b)
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+static uint64_t
+tile_key(int tx, int tz)
+{
+	return ((uint64_t)(uint32_t)tx << 32) | (uint32_t)tz;
+}
+
+Noise::Biome
+Noise::biome_for(const Climate &climate)
+{
+	// Perlin noise rarely strays far from 0.5, so the thresholds sit
+	// close to it
+	if (climate.continentalness < 0.42f)
+		return Biome::Ocean;
+	if (climate.continentalness < 0.45f)
+		return Biome::Beach;
+
+	if (climate.temperature < 0.4f)
+		return (climate.humidity < 0.5f) ? Biome::Tundra : Biome::Taiga;
+	if (climate.temperature > 0.6f)
+		return (climate.humidity < 0.5f) ? Biome::Desert : Biome::Savanna;
+	return (climate.humidity < 0.5f) ? Biome::Plains : Biome::Forest;
+}
+
+Noise::BiomeMaterials
+Noise::materials_for(Biome biome)
+{
+	using M = GFX::VoxelMaterial;
+
+	switch (biome)
+	{
+		case Biome::Ocean:
+		case Biome::Beach:
+		case Biome::Desert:
+			return { M::Sand, M::Sand };
+		case Biome::Tundra:
+			return { M::Snow, M::Dirt };
+		case Biome::Savanna:
+		case Biome::Plains:
+		case Biome::Forest:
+		case Biome::Taiga:
+			break;
+	}
+	return { M::Grass, M::Dirt };
+}
+
+Noise::BiomeMap::BiomeMap(const BiomeSettings &settings) :
+	config(settings),
+	samples(0),
+	temperature(0, settings.seed * 3),
+	humidity(0, settings.seed * 3 + 1),
+	continentalness(0, settings.seed * 3 + 2),
+	tiles(settings.cache_bytes)
+{
+	if (settings.step <= 0 || settings.tile_size <= 0)
+		throw std::invalid_argument("BiomeMap: step or tile_size not positive");
+	if (settings.tile_size % settings.step)
+		throw std::invalid_argument(
+			"BiomeMap: tile_size not a multiple of step");
+
+	samples = settings.tile_size / settings.step + 1;
+}
+
+Noise::Climate
+Noise::BiomeMap::climate_at(int x, int z) const
+{
+	int tx = floor_div(x, config.tile_size);
+	int tz = floor_div(z, config.tile_size);
+	return interpolate(
+		*tile(tx, tz), x - tx * config.tile_size,
+		z - tz * config.tile_size);
+}
+
+Noise::Biome
+Noise::BiomeMap::biome_at(int x, int z) const
+{
+	return biome_for(climate_at(x, z));
+}
+
+void
+Noise::BiomeMap::climate_rect(
+	int x, int z, int width, int depth, Climate *out
+) const {
+	// Neighbouring columns mostly share a tile, so it is only looked up
+	// again once they leave it
+	std::shared_ptr<const Tile> current;
+	int current_tx = 0, current_tz = 0;
+
+	for (int iz = 0; iz < depth; iz++)
+	for (int ix = 0; ix < width; ix++)
+	{
+		int tx = floor_div(x + ix, config.tile_size);
+		int tz = floor_div(z + iz, config.tile_size);
+		if (!current || tx != current_tx || tz != current_tz)
+		{
+			current = tile(tx, tz);
+			current_tx = tx;
+			current_tz = tz;
+		}
+
+		out[(size_t)iz * width + ix] = interpolate(
+			*current, x + ix - tx * config.tile_size,
+			z + iz - tz * config.tile_size);
+	}
+}
+
+void
+Noise::BiomeMap::paint(GFX::DynamicVolume &volume, int x, int z) const
+{
+	const int x_size = volume.x_size();
+	const int y_size = volume.y_size();
+	const int z_size = volume.z_size();
+
+	std::vector<Climate> climates((size_t)x_size * z_size);
+	climate_rect(x, z, x_size, z_size, climates.data());
+
+	for (int iz = 0; iz < z_size; iz++)
+	for (int ix = 0; ix < x_size; ix++)
+	{
+		BiomeMaterials materials =
+			materials_for(biome_for(climates[(size_t)iz * x_size + ix]));
+
+		// Solid voxels since the last empty one, counting the top of
+		// the volume as empty
+		int depth = 0;
+		for (int iy = y_size - 1; iy >= 0; iy--)
+		{
+			GFX::Voxel &voxel = volume.voxel_at(ix, iy, iz);
+			if (!voxel.material)
+			{
+				depth = 0;
+				continue;
+			}
+
+			GFX::VoxelMaterial material = GFX::VoxelMaterial::Stone;
+			if (depth == 0)
+				material = materials.surface;
+			else if (depth <= config.soil_depth)
+				material = materials.subsurface;
+			voxel.material = (uint16_t)material;
+			depth++;
+		}
+	}
+}
+
+size_t
+Noise::BiomeMap::tile_count() const
+{
+	return tiles.stats().entries;
+}
+
+void
+Noise::BiomeMap::clear()
+{
+	tiles.clear();
+}
+
+std::shared_ptr<const Noise::BiomeMap::Tile>
+Noise::BiomeMap::tile(int tx, int tz) const
+{
+	// Generated without the cache's lock, so other tiles can be looked
+	// up meanwhile. If another thread got here first its tile is kept,
+	// both are the same anyway.
+	return tiles.get(
+		tile_key(tx, tz), [&] { return generate(tx, tz); },
+		[](const Tile &tile)
+		{
+			return sizeof(Tile) + tile.size() * sizeof(Climate);
+		});
+}
+
+std::shared_ptr<const Noise::BiomeMap::Tile>
+Noise::BiomeMap::generate(int tx, int tz) const
+{
+	const int count = samples * samples;
+	std::vector<double> xs(count), zs(count), ys(count, 0.0);
+	std::vector<double> climate_xs(count), climate_zs(count);
+	std::vector<double> values(count);
+
+	for (int iz = 0; iz < samples; iz++)
+	for (int ix = 0; ix < samples; ix++)
+	{
+		int i = iz * samples + ix;
+		double x = (double)tx * config.tile_size + ix * config.step;
+		double z = (double)tz * config.tile_size + iz * config.step;
+		climate_xs[i] = wrap_coordinate(x / config.climate_scale);
+		climate_zs[i] = wrap_coordinate(z / config.climate_scale);
+		xs[i] = wrap_coordinate(x / config.continent_scale);
+		zs[i] = wrap_coordinate(z / config.continent_scale);
+	}
+
+	auto tile = std::make_shared<Tile>(count);
+	temperature.octave_noise_batch(
+		climate_xs.data(), climate_zs.data(), ys.data(), values.data(),
+		count, config.octaves, config.persistence);
+	for (int i = 0; i < count; i++)
+		(*tile)[i].temperature = (float)values[i];
+
+	humidity.octave_noise_batch(
+		climate_xs.data(), climate_zs.data(), ys.data(), values.data(),
+		count, config.octaves, config.persistence);
+	for (int i = 0; i < count; i++)
+		(*tile)[i].humidity = (float)values[i];
+
+	continentalness.octave_noise_batch(
+		xs.data(), zs.data(), ys.data(), values.data(), count,
+		config.octaves, config.persistence);
+	for (int i = 0; i < count; i++)
+		(*tile)[i].continentalness = (float)values[i];
+
+	return tile;
+}
+
+Noise::Climate
+Noise::BiomeMap::interpolate(const Tile &tile, int lx, int lz) const
+{
+	int ix = lx / config.step;
+	int iz = lz / config.step;
+	float fx = (float)(lx - ix * config.step) / config.step;
+	float fz = (float)(lz - iz * config.step) / config.step;
+
+	const Climate &c00 = tile[iz * samples + ix];
+	const Climate &c10 = tile[iz * samples + ix + 1];
+	const Climate &c01 = tile[(iz + 1) * samples + ix];
+	const Climate &c11 = tile[(iz + 1) * samples + ix + 1];
+
+	auto lerp = [&](float Climate::*field)
+	{
+		float bottom = c00.*field + fx * (c10.*field - c00.*field);
+		float top = c01.*field + fx * (c11.*field - c01.*field);
+		return bottom + fz * (top - bottom);
+	};
+
+	Climate climate;
+	climate.temperature = lerp(&Climate::temperature);
+	climate.humidity = lerp(&Climate::humidity);
+	climate.continentalness = lerp(&Climate::continentalness);
+	return climate;
+}
@@ -0,0 +1,287 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <graphics/noise/erosion.h>
+#include <parallel.h>
+
+// The grid is kept as separate arrays and every pass only writes the cells
+// of its own rows, so rows split across threads without locking. The inner
+// loops over X use min/max rather than branches so that they vectorize.
+// Cells at the border run the same code with their outside neighbours
+// clamped to themselves. Their outflows towards the border stay 0, and
+// inflows from a clamped neighbour are masked out.
+
+namespace
+{
+	/// State of the simulation, one value per cell.
+	struct Grid
+	{
+		int width, height;
+		std::vector<float> ground, ground_next;
+		std::vector<float> water;
+		std::vector<float> sediment, sediment_next;
+
+		/// Sediment per unit of water, refreshed by every flow pass.
+		std::vector<float> concentration;
+
+		/// Outflows towards -X, +X, -Y and +Y, per unit of time.
+		std::vector<float> left, right, down, up;
+
+		Grid(const float *heights, int width, int height) :
+			width(width), height(height),
+			ground(heights, heights + (size_t)width * height),
+			ground_next(ground.size()), water(ground.size()),
+			sediment(ground.size()), sediment_next(ground.size()),
+			concentration(ground.size()),
+			left(ground.size()), right(ground.size()),
+			down(ground.size()), up(ground.size()) {};
+	};
+
+	/// Pointers to a row of a grid array and to its neighbouring rows,
+	/// clamped to the grid.
+	template <typename T>
+	struct Rows
+	{
+		T *row, *down, *up;
+
+		Rows(T *data, const Grid &g, int y) :
+			row(data + (size_t)y * g.width),
+			down(data + (size_t)std::max(y - 1, 0) * g.width),
+			up(data + (size_t)std::min(y + 1, g.height - 1) * g.width) {};
+	};
+
+	template <typename T>
+	Rows<T>
+	rows(std::vector<T> &data, const Grid &g, int y)
+	{
+		return Rows<T>(data.data(), g, y);
+	}
+
+	template <typename T>
+	Rows<const T>
+	rows(const std::vector<T> &data, const Grid &g, int y)
+	{
+		return Rows<const T>(data.data(), g, y);
+	}
+
+	/// Calls cell(x, x - 1, x + 1) for every cell of a row, with the
+	/// neighbours clamped at the ends. The interior loop has no border
+	/// checks, so it vectorizes.
+	template <typename F>
+	inline void
+	for_cells(int width, F &&cell)
+	{
+		int last = width - 1;
+		cell(0, 0, std::min(1, last));
+		for (int x = 1; x < last; x++)
+			cell(x, x - 1, x + 1);
+		if (last > 0)
+			cell(last, last - 1, last);
+	}
+
+	/// Returns the ground sliding onto a cell at height h from a neighbour
+	/// at height n, negative if it slides off.
+	inline float
+	talus_slide(float h, float n, float talus)
+	{
+		return std::max(n - h - talus, 0.0f) - std::max(h - n - talus, 0.0f);
+	}
+
+	/// Accelerates the outflows of row y by the differences of ground
+	/// and water levels and slows them by friction, scaled down so that
+	/// no more water leaves a cell in a step than it holds.
+	void
+	flow_row(Grid &g, const Noise::Erosion &s, int y)
+	{
+		auto b = rows(g.ground, g, y);
+		auto d = rows(g.water, g, y);
+		const float *sed = g.sediment.data() + (size_t)y * g.width;
+		float *c = g.concentration.data() + (size_t)y * g.width;
+		float *fl = g.left.data() + (size_t)y * g.width;
+		float *fr = g.right.data() + (size_t)y * g.width;
+		float *fd = g.down.data() + (size_t)y * g.width;
+		float *fu = g.up.data() + (size_t)y * g.width;
+		float dt = s.dt;
+		float k = s.dt * s.gravity;
+		float keep = std::max(0.0f, 1.0f - s.friction * s.dt);
+
+		for_cells(g.width, [=](int x, int xl, int xr)
+		{
+			float level = b.row[x] + d.row[x];
+			float l = std::max(0.0f,
+				fl[x] * keep + k * (level - b.row[xl] - d.row[xl]));
+			float rt = std::max(0.0f,
+				fr[x] * keep + k * (level - b.row[xr] - d.row[xr]));
+			float dn = std::max(0.0f,
+				fd[x] * keep + k * (level - b.down[x] - d.down[x]));
+			float u = std::max(0.0f,
+				fu[x] * keep + k * (level - b.up[x] - d.up[x]));
+
+			float out = (l + rt + dn + u) * dt;
+			float scale = d.row[x]
+				/ std::max(out, std::max(d.row[x], 1e-9f));
+			fl[x] = l * scale;
+			fr[x] = rt * scale;
+			fd[x] = dn * scale;
+			fu[x] = u * scale;
+			c[x] = sed[x] / std::max(d.row[x], 1e-9f);
+		});
+	}
+
+	/// Moves the sediment of row y along with the water, each outflow
+	/// taking its share of the sediment of the cell it leaves.
+	void
+	transport_row(Grid &g, const Noise::Erosion &s, int y)
+	{
+		auto c = rows(g.concentration, g, y);
+		auto fd = rows(g.down, g, y);
+		auto fu = rows(g.up, g, y);
+		const float *sed = g.sediment.data() + (size_t)y * g.width;
+		const float *fl = g.left.data() + (size_t)y * g.width;
+		const float *fr = g.right.data() + (size_t)y * g.width;
+		float *next = g.sediment_next.data() + (size_t)y * g.width;
+		float has_down = (y > 0);
+		float has_up = (y < g.height - 1);
+		float dt = s.dt;
+
+		for_cells(g.width, [=](int x, int xl, int xr)
+		{
+			float in = fr[xl] * c.row[xl] * (xl != x)
+				+ fl[xr] * c.row[xr] * (xr != x)
+				+ fu.down[x] * c.down[x] * has_down
+				+ fd.up[x] * c.up[x] * has_up;
+			float out = (fl[x] + fr[x] + fd.row[x] + fu.row[x]) * c.row[x];
+			next[x] = std::max(0.0f, sed[x] + dt * (in - out));
+		});
+	}
+
+	/// Moves the water of row y along the outflows, dissolves or deposits
+	/// sediment depending on how much the water can carry, lets ground
+	/// steeper than the talus slope slide, and rains and evaporates.
+	void
+	erode_row(Grid &g, const Noise::Erosion &s, int y)
+	{
+		auto b = rows(g.ground, g, y);
+		auto fd = rows(g.down, g, y);
+		auto fu = rows(g.up, g, y);
+		const float *fl = g.left.data() + (size_t)y * g.width;
+		const float *fr = g.right.data() + (size_t)y * g.width;
+		float *d = g.water.data() + (size_t)y * g.width;
+		float *sed = g.sediment_next.data() + (size_t)y * g.width;
+		float *next = g.ground_next.data() + (size_t)y * g.width;
+		float has_down = (y > 0);
+		float has_up = (y < g.height - 1);
+		float dt = s.dt;
+		float shallow_depth = s.shallow_depth;
+		float capacity = s.capacity;
+		float min_slope = s.min_slope;
+		float dissolving = s.dissolving;
+		float deposition = s.deposition;
+		float talus = s.talus;
+		float sliding = s.sliding;
+		float keep = 1.0f - s.evaporation * s.dt;
+		float rain = s.rain * s.dt;
+
+		for_cells(g.width, [=](int x, int xl, int xr)
+		{
+			float in = fr[xl] * (xl != x) + fl[xr] * (xr != x)
+				+ fu.down[x] * has_down + fd.up[x] * has_up;
+			float out = fl[x] + fr[x] + fd.row[x] + fu.row[x];
+			float water = std::max(0.0f, d[x] + dt * (in - out));
+
+			// Water carries sediment in proportion to its speed, which
+			// drops in pools. Shallow water counts as shallow_depth
+			// deep, so a trickle doesn't speed up without bound.
+			float fx = (fr[xl] - fl[x] + fr[x] - fl[xr]) * 0.5f;
+			float fy = (fu.down[x] - fd.row[x] + fu.row[x] - fd.up[x]) * 0.5f;
+			float speed = std::sqrt(fx * fx + fy * fy)
+				/ std::max(water, shallow_depth);
+
+			// Sine of the ground tilt from its central differences
+			float gx = (b.row[xr] - b.row[xl]) * 0.5f;
+			float gy = (b.up[x] - b.down[x]) * 0.5f;
+			float g2 = gx * gx + gy * gy;
+			float slope = std::sqrt(g2 / (1.0f + g2));
+
+			float carry = capacity * std::max(slope, min_slope) * speed;
+			float missing = carry - sed[x];
+			float amount = dt * missing
+				* ((missing > 0) ? dissolving : deposition);
+
+			// Pairwise, so the ground sliding off a cell is exactly
+			// what its neighbours gain
+			float h = b.row[x];
+			float slide = talus_slide(h, b.row[xl], talus)
+				+ talus_slide(h, b.row[xr], talus)
+				+ talus_slide(h, b.down[x], talus)
+				+ talus_slide(h, b.up[x], talus);
+
+			next[x] = h - amount + sliding * slide;
+			sed[x] += amount;
+			d[x] = water * keep + rain;
+		});
+	}
+
+	/// Runs fn(y) for every row, split across threads.
+	template <typename F>
+	void
+	for_rows(const Grid &g, int threads, F &&fn)
+	{
+		Parallel::for_ranges(0, g.height, threads, [&](int from, int to)
+		{
+			for (int y = from; y < to; y++)
+				fn(y);
+		});
+	}
+}
+
+void
+Noise::erode(
+	float *heights, int width, int height, const Erosion &settings,
+	int threads
+) {
+	if (width <= 0 || height <= 0)
+		return;
+
+	Grid g(heights, width, height);
+	std::fill(g.water.begin(), g.water.end(), settings.rain * settings.dt);
+
+	for (int i = 0; i < settings.iterations; i++)
+	{
+		for_rows(g, threads, [&](int y) { flow_row(g, settings, y); });
+		for_rows(g, threads, [&](int y) { transport_row(g, settings, y); });
+		for_rows(g, threads, [&](int y) { erode_row(g, settings, y); });
+		std::swap(g.ground, g.ground_next);
+		std::swap(g.sediment, g.sediment_next);
+	}
+
+	// Sediment still carried settles where the water is
+	for (size_t i = 0; i < g.ground.size(); i++)
+		heights[i] = g.ground[i] + g.sediment[i];
+}
+
+void
+Noise::erode(::Image &image, const Erosion &settings, int threads)
+{
+	int width = image.width();
+	int height = image.height();
+	int channels = image.channel_count();
+	float scale = settings.relief * width;
+
+	std::vector<float> heights((size_t)width * height);
+	for (size_t i = 0; i < heights.size(); i++)
+		heights[i] = image.data[i * channels] / 255.0f * scale;
+
+	erode(heights.data(), width, height, settings, threads);
+
+	// Alpha, if any, is the 4th channel
+	int colors = std::min(channels, 3);
+	for (size_t i = 0; i < heights.size(); i++)
+	{
+		float value = std::min(std::max(heights[i] / scale, 0.0f), 1.0f);
+		uint8_t gray = (uint8_t)(255.0f * value + 0.5f);
+		for (int c = 0; c < colors; c++)
+			image.data[i * channels + c] = gray;
+	}
+}
@@ -0,0 +1,144 @@
+// Compiled with -mavx2, only reached after a runtime CPU check.
+#include <immintrin.h>
+#include <graphics/noise/simd.h>
+#include <graphics/noise/perlin_kernel.h>
+
+namespace
+{
+	/// 4 doubles per vector, hash indices in the 4 lanes of an __m128i.
+	struct AVX2Double
+	{
+		using Real = double;
+		using V = __m256d;
+		using I = __m128i;
+		using M = __m256d;
+		static const int width = 4;
+
+		static V load(const double *p) { return _mm256_loadu_pd(p); }
+		static void store(double *p, V v) { _mm256_storeu_pd(p, v); }
+		static V set1(double v) { return _mm256_set1_pd(v); }
+		static V add(V a, V b) { return _mm256_add_pd(a, b); }
+		static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+		static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+		static V div(V a, V b) { return _mm256_div_pd(a, b); }
+		static V neg(V v)
+		{
+			return _mm256_xor_pd(v, _mm256_set1_pd(-0.0));
+		}
+		static V trunc(V v)
+		{
+			return _mm256_round_pd(
+				v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		}
+		/// Returns `a` in lanes where `m` is set, `b` elsewhere.
+		static V select(M m, V a, V b) { return _mm256_blendv_pd(b, a, m); }
+		/// Lanes where a > b.
+		static M gt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+		/// Packs the top bit of each lane of a mask into an int.
+		static int bits(M m) { return _mm256_movemask_pd(m); }
+
+		static I to_int(V v) { return _mm256_cvttpd_epi32(v); }
+		static I iset1(int v) { return _mm_set1_epi32(v); }
+		static I iadd(I a, I b) { return _mm_add_epi32(a, b); }
+		static I iand(I a, I b) { return _mm_and_si128(a, b); }
+		static I ior(I a, I b) { return _mm_or_si128(a, b); }
+		static I icmpeq(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+		static I icmplt(I a, I b) { return _mm_cmplt_epi32(a, b); }
+		static I lookup(const int *table, I idx)
+		{
+			return _mm_i32gather_epi32(table, idx, 4);
+		}
+		/// Widens a 32-bit lane mask to 64-bit double lanes.
+		static M mask(I m)
+		{
+			return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(m));
+		}
+	};
+	
+	/// 8 floats per vector, hash indices in the 8 lanes of an __m256i.
+	struct AVX2Float
+	{
+		using Real = float;
+		using V = __m256;
+		using I = __m256i;
+		using M = __m256;
+		static const int width = 8;
+
+		static V load(const float *p) { return _mm256_loadu_ps(p); }
+		static void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+		static V set1(float v) { return _mm256_set1_ps(v); }
+		static V add(V a, V b) { return _mm256_add_ps(a, b); }
+		static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+		static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+		static V div(V a, V b) { return _mm256_div_ps(a, b); }
+		static V neg(V v)
+		{
+			return _mm256_xor_ps(v, _mm256_set1_ps(-0.0f));
+		}
+		static V trunc(V v)
+		{
+			return _mm256_round_ps(
+				v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		}
+		/// Returns `a` in lanes where `m` is set, `b` elsewhere.
+		static V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+		/// Lanes where a > b.
+		static M gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		/// Packs the top bit of each lane of a mask into an int.
+		static int bits(M m) { return _mm256_movemask_ps(m); }
+
+		static I to_int(V v) { return _mm256_cvttps_epi32(v); }
+		static I iset1(int v) { return _mm256_set1_epi32(v); }
+		static I iadd(I a, I b) { return _mm256_add_epi32(a, b); }
+		static I iand(I a, I b) { return _mm256_and_si256(a, b); }
+		static I ior(I a, I b) { return _mm256_or_si256(a, b); }
+		static I icmpeq(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+		static I icmplt(I a, I b) { return _mm256_cmpgt_epi32(b, a); }
+		static I lookup(const int *table, I idx)
+		{
+			return _mm256_i32gather_epi32(table, idx, 4);
+		}
+		static M mask(I m) { return _mm256_castsi256_ps(m); }
+	};
+}
+
+int
+Noise::Kernel::perlin_octave_noise_avx2(
+	const int *perms, const double *x, const double *y, const double *z,
+	double *out, int count, int octaves, double persistence
+) {
+	return perlin_octave_noise<AVX2Double>(
+		perms, x, y, z, out, count, octaves, persistence);
+}
+
+int
+Noise::Kernel::perlin_octave_noise_avx2(
+	const int *perms, const float *x, const float *y, const float *z,
+	float *out, int count, int octaves, float persistence
+) {
+	return perlin_octave_noise<AVX2Float>(
+		perms, x, y, z, out, count, octaves, persistence);
+}
+
+int
+Noise::Kernel::perlin_octave_threshold_avx2(
+	const int *perms, const double *x, const double *y, const double *z,
+	unsigned char *out, int count, int octaves, double persistence,
+	double threshold, double low, double high, double margin,
+	bool round_to_float
+) {
+	return perlin_octave_threshold<AVX2Double>(
+		perms, x, y, z, out, count, octaves, persistence, threshold, low,
+		high, margin, round_to_float);
+}
+
+int
+Noise::Kernel::perlin_octave_threshold_avx2(
+	const int *perms, const float *x, const float *y, const float *z,
+	unsigned char *out, int count, int octaves, float persistence,
+	double threshold, float low, float high, double margin
+) {
+	return perlin_octave_threshold<AVX2Float>(
+		perms, x, y, z, out, count, octaves, persistence, threshold, low,
+		high, margin);
+}
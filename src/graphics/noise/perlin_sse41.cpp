@@ -0,0 +1,144 @@
+// Compiled with -msse4.1, only reached after a runtime CPU check.
+#include <smmintrin.h>
+#include <graphics/noise/simd.h>
+#include <graphics/noise/perlin_kernel.h>
+
+namespace
+{
+	/// 2 doubles per vector, hash indices in the low 2 lanes of an
+	/// __m128i. SSE has no gather, so table lookups are done per lane.
+	struct SSE41Double
+	{
+		using Real = double;
+		using V = __m128d;
+		using I = __m128i;
+		using M = __m128d;
+		static const int width = 2;
+
+		static V load(const double *p) { return _mm_loadu_pd(p); }
+		static void store(double *p, V v) { _mm_storeu_pd(p, v); }
+		static V set1(double v) { return _mm_set1_pd(v); }
+		static V add(V a, V b) { return _mm_add_pd(a, b); }
+		static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+		static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+		static V div(V a, V b) { return _mm_div_pd(a, b); }
+		static V neg(V v) { return _mm_xor_pd(v, _mm_set1_pd(-0.0)); }
+		static V trunc(V v)
+		{
+			return _mm_round_pd(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		}
+		/// Returns `a` in lanes where `m` is set, `b` elsewhere.
+		static V select(M m, V a, V b) { return _mm_blendv_pd(b, a, m); }
+		/// Lanes where a > b.
+		static M gt(V a, V b) { return _mm_cmpgt_pd(a, b); }
+		/// Packs the top bit of each lane of a mask into an int.
+		static int bits(M m) { return _mm_movemask_pd(m); }
+
+		static I to_int(V v) { return _mm_cvttpd_epi32(v); }
+		static I iset1(int v) { return _mm_set1_epi32(v); }
+		static I iadd(I a, I b) { return _mm_add_epi32(a, b); }
+		static I iand(I a, I b) { return _mm_and_si128(a, b); }
+		static I ior(I a, I b) { return _mm_or_si128(a, b); }
+		static I icmpeq(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+		static I icmplt(I a, I b) { return _mm_cmplt_epi32(a, b); }
+		static I lookup(const int *table, I idx)
+		{
+			return _mm_setr_epi32(
+				table[_mm_cvtsi128_si32(idx)],
+				table[_mm_extract_epi32(idx, 1)],
+				0, 0);
+		}
+		/// Widens a 32-bit lane mask to 64-bit double lanes.
+		static M mask(I m)
+		{
+			return _mm_castsi128_pd(_mm_cvtepi32_epi64(m));
+		}
+	};
+	
+	/// 4 floats per vector, hash indices in the 4 lanes of an __m128i.
+	struct SSE41Float
+	{
+		using Real = float;
+		using V = __m128;
+		using I = __m128i;
+		using M = __m128;
+		static const int width = 4;
+
+		static V load(const float *p) { return _mm_loadu_ps(p); }
+		static void store(float *p, V v) { _mm_storeu_ps(p, v); }
+		static V set1(float v) { return _mm_set1_ps(v); }
+		static V add(V a, V b) { return _mm_add_ps(a, b); }
+		static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+		static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+		static V div(V a, V b) { return _mm_div_ps(a, b); }
+		static V neg(V v) { return _mm_xor_ps(v, _mm_set1_ps(-0.0f)); }
+		static V trunc(V v)
+		{
+			return _mm_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		}
+		/// Returns `a` in lanes where `m` is set, `b` elsewhere.
+		static V select(M m, V a, V b) { return _mm_blendv_ps(b, a, m); }
+		/// Lanes where a > b.
+		static M gt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+		/// Packs the top bit of each lane of a mask into an int.
+		static int bits(M m) { return _mm_movemask_ps(m); }
+
+		static I to_int(V v) { return _mm_cvttps_epi32(v); }
+		static I iset1(int v) { return _mm_set1_epi32(v); }
+		static I iadd(I a, I b) { return _mm_add_epi32(a, b); }
+		static I iand(I a, I b) { return _mm_and_si128(a, b); }
+		static I ior(I a, I b) { return _mm_or_si128(a, b); }
+		static I icmpeq(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+		static I icmplt(I a, I b) { return _mm_cmplt_epi32(a, b); }
+		static I lookup(const int *table, I idx)
+		{
+			return _mm_setr_epi32(
+				table[_mm_cvtsi128_si32(idx)],
+				table[_mm_extract_epi32(idx, 1)],
+				table[_mm_extract_epi32(idx, 2)],
+				table[_mm_extract_epi32(idx, 3)]);
+		}
+		static M mask(I m) { return _mm_castsi128_ps(m); }
+	};
+}
+
+int
+Noise::Kernel::perlin_octave_noise_sse41(
+	const int *perms, const double *x, const double *y, const double *z,
+	double *out, int count, int octaves, double persistence
+) {
+	return perlin_octave_noise<SSE41Double>(
+		perms, x, y, z, out, count, octaves, persistence);
+}
+
+int
+Noise::Kernel::perlin_octave_noise_sse41(
+	const int *perms, const float *x, const float *y, const float *z,
+	float *out, int count, int octaves, float persistence
+) {
+	return perlin_octave_noise<SSE41Float>(
+		perms, x, y, z, out, count, octaves, persistence);
+}
+
+int
+Noise::Kernel::perlin_octave_threshold_sse41(
+	const int *perms, const double *x, const double *y, const double *z,
+	unsigned char *out, int count, int octaves, double persistence,
+	double threshold, double low, double high, double margin,
+	bool round_to_float
+) {
+	return perlin_octave_threshold<SSE41Double>(
+		perms, x, y, z, out, count, octaves, persistence, threshold, low,
+		high, margin, round_to_float);
+}
+
+int
+Noise::Kernel::perlin_octave_threshold_sse41(
+	const int *perms, const float *x, const float *y, const float *z,
+	unsigned char *out, int count, int octaves, float persistence,
+	double threshold, float low, float high, double margin
+) {
+	return perlin_octave_threshold<SSE41Float>(
+		perms, x, y, z, out, count, octaves, persistence, threshold, low,
+		high, margin);
+}
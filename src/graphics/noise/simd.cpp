@@ -0,0 +1,234 @@
+#include <graphics/noise/simd.h>
+
+// The x86 kernels are only compiled in on x86 targets, see CMakeLists.txt.
+
+/// Queries the running CPU for the best supported instruction set.
+static Noise::SimdLevel
+detect_simd_level()
+{
+#if defined(NOISE_X86_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return Noise::SimdLevel::AVX2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return Noise::SimdLevel::SSE41;
+#endif
+	return Noise::SimdLevel::Scalar;
+}
+
+Noise::SimdLevel
+Noise::supported_simd_level()
+{
+	static const SimdLevel supported = detect_simd_level();
+	return supported;
+}
+
+/// Level in use. Function-local so that noise generated during static
+/// initialization of other translation units already sees the detected
+/// level.
+static Noise::SimdLevel &
+active_level()
+{
+	static Noise::SimdLevel level = Noise::supported_simd_level();
+	return level;
+}
+
+Noise::SimdLevel
+Noise::simd_level()
+{
+	return active_level();
+}
+
+void
+Noise::set_simd_level(SimdLevel level)
+{
+	SimdLevel supported = supported_simd_level();
+	active_level() = ((int)level > (int)supported) ? supported : level;
+}
+
+const char *
+Noise::to_string(SimdLevel level)
+{
+	switch (level)
+	{
+		case SimdLevel::AVX2:
+			return "avx2";
+		case SimdLevel::SSE41:
+			return "sse4.1";
+		case SimdLevel::Scalar:
+		default:
+			return "scalar";
+	}
+}
+
+int
+Noise::Kernel::perlin_octave_noise(
+	const int *perms, const double *x, const double *y, const double *z,
+	double *out, int count, int octaves, double persistence
+) {
+	switch (simd_level())
+	{
+#ifdef NOISE_X86_KERNELS
+		case SimdLevel::AVX2:
+			return perlin_octave_noise_avx2(
+				perms, x, y, z, out, count, octaves, persistence);
+		case SimdLevel::SSE41:
+			return perlin_octave_noise_sse41(
+				perms, x, y, z, out, count, octaves, persistence);
+#endif
+		case SimdLevel::Scalar:
+		default:
+			return 0;
+	}
+}
+
+int
+Noise::Kernel::perlin_octave_noise(
+	const int *perms, const float *x, const float *y, const float *z,
+	float *out, int count, int octaves, float persistence
+) {
+	switch (simd_level())
+	{
+#ifdef NOISE_X86_KERNELS
+		case SimdLevel::AVX2:
+			return perlin_octave_noise_avx2(
+				perms, x, y, z, out, count, octaves, persistence);
+		case SimdLevel::SSE41:
+			return perlin_octave_noise_sse41(
+				perms, x, y, z, out, count, octaves, persistence);
+#endif
+		case SimdLevel::Scalar:
+		default:
+			return 0;
+	}
+}
+
+int
+Noise::Kernel::perlin_octave_threshold(
+	const int *perms, const double *x, const double *y, const double *z,
+	unsigned char *out, int count, int octaves, double persistence,
+	double threshold, double low, double high, double margin,
+	bool round_to_float
+) {
+	switch (simd_level())
+	{
+#ifdef NOISE_X86_KERNELS
+		case SimdLevel::AVX2:
+			return perlin_octave_threshold_avx2(
+				perms, x, y, z, out, count, octaves, persistence,
+				threshold, low, high, margin, round_to_float);
+		case SimdLevel::SSE41:
+			return perlin_octave_threshold_sse41(
+				perms, x, y, z, out, count, octaves, persistence,
+				threshold, low, high, margin, round_to_float);
+#endif
+		case SimdLevel::Scalar:
+		default:
+			return 0;
+	}
+}
+
+int
+Noise::Kernel::perlin_octave_threshold(
+	const int *perms, const float *x, const float *y, const float *z,
+	unsigned char *out, int count, int octaves, float persistence,
+	double threshold, float low, float high, double margin
+) {
+	switch (simd_level())
+	{
+#ifdef NOISE_X86_KERNELS
+		case SimdLevel::AVX2:
+			return perlin_octave_threshold_avx2(
+				perms, x, y, z, out, count, octaves, persistence,
+				threshold, low, high, margin);
+		case SimdLevel::SSE41:
+			return perlin_octave_threshold_sse41(
+				perms, x, y, z, out, count, octaves, persistence,
+				threshold, low, high, margin);
+#endif
+		case SimdLevel::Scalar:
+		default:
+			return 0;
+	}
+}
+
+int
+Noise::Kernel::worley_nearest(
+	const double *fx, const double *fy, const double *fz, const double *x,
+	const double *y, const double *z, double *f1, double *f2, int count
+) {
+	switch (simd_level())
+	{
+#ifdef NOISE_X86_KERNELS
+		case SimdLevel::AVX2:
+			return worley_nearest_avx2(
+				fx, fy, fz, x, y, z, f1, f2, count);
+		case SimdLevel::SSE41:
+			return worley_nearest_sse41(
+				fx, fy, fz, x, y, z, f1, f2, count);
+#endif
+		case SimdLevel::Scalar:
+		default:
+			return 0;
+	}
+}
+
+int
+Noise::Kernel::worley_nearest(
+	const float *fx, const float *fy, const float *fz, const float *x,
+	const float *y, const float *z, float *f1, float *f2, int count
+) {
+	switch (simd_level())
+	{
+#ifdef NOISE_X86_KERNELS
+		case SimdLevel::AVX2:
+			return worley_nearest_avx2(
+				fx, fy, fz, x, y, z, f1, f2, count);
+		case SimdLevel::SSE41:
+			return worley_nearest_sse41(
+				fx, fy, fz, x, y, z, f1, f2, count);
+#endif
+		case SimdLevel::Scalar:
+		default:
+			return 0;
+	}
+}
+
+int
+Noise::Kernel::worley_nearest_cells(
+	uint32_t seed, const double *x, const double *y, const double *z,
+	double *f1, double *f2, int count
+) {
+	// Hashing 27 cells in 2 lanes loses to the scalar path stepping
+	// along X with 9 hashes, so SSE4.1 leaves doubles to it.
+	switch (simd_level())
+	{
+#ifdef NOISE_X86_KERNELS
+		case SimdLevel::AVX2:
+			return worley_nearest_cells_avx2(seed, x, y, z, f1, f2, count);
+#endif
+		case SimdLevel::SSE41:
+		case SimdLevel::Scalar:
+		default:
+			return 0;
+	}
+}
+
+int
+Noise::Kernel::worley_nearest_cells(
+	uint32_t seed, const float *x, const float *y, const float *z,
+	float *f1, float *f2, int count
+) {
+	switch (simd_level())
+	{
+#ifdef NOISE_X86_KERNELS
+		case SimdLevel::AVX2:
+			return worley_nearest_cells_avx2(seed, x, y, z, f1, f2, count);
+		case SimdLevel::SSE41:
+			return worley_nearest_cells_sse41(seed, x, y, z, f1, f2, count);
+#endif
+		case SimdLevel::Scalar:
+		default:
+			return 0;
+	}
+}
@@ -0,0 +1,105 @@
+// Compiled with -mavx2, only reached after a runtime CPU check.
+#include <immintrin.h>
+#include <graphics/noise/simd.h>
+#include <graphics/noise/worley_kernel.h>
+
+namespace
+{
+	/// 4 doubles per vector, int lanes in the 4 lanes of an __m128i.
+	struct AVX2Double
+	{
+		using Real = double;
+		using V = __m256d;
+		using I = __m128i;
+		static const int width = 4;
+
+		static V load(const double *p) { return _mm256_loadu_pd(p); }
+		static void store(double *p, V v) { _mm256_storeu_pd(p, v); }
+		static V set1(double v) { return _mm256_set1_pd(v); }
+		static V add(V a, V b) { return _mm256_add_pd(a, b); }
+		static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+		static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+		static V min(V a, V b) { return _mm256_min_pd(a, b); }
+		static V max(V a, V b) { return _mm256_max_pd(a, b); }
+		static V floor(V v)
+		{
+			return _mm256_round_pd(
+				v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+		}
+		static I to_int(V v) { return _mm256_cvttpd_epi32(v); }
+		static V to_real(I v) { return _mm256_cvtepi32_pd(v); }
+
+		static I iset1(int v) { return _mm_set1_epi32(v); }
+		static I iadd(I a, I b) { return _mm_add_epi32(a, b); }
+		static I iand(I a, I b) { return _mm_and_si128(a, b); }
+		static I ixor(I a, I b) { return _mm_xor_si128(a, b); }
+		static I imul(I a, I b) { return _mm_mullo_epi32(a, b); }
+		template <int n>
+		static I isrl(I v) { return _mm_srli_epi32(v, n); }
+	};
+
+	/// 8 floats per vector, int lanes in the 8 lanes of an __m256i.
+	struct AVX2Float
+	{
+		using Real = float;
+		using V = __m256;
+		using I = __m256i;
+		static const int width = 8;
+
+		static V load(const float *p) { return _mm256_loadu_ps(p); }
+		static void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+		static V set1(float v) { return _mm256_set1_ps(v); }
+		static V add(V a, V b) { return _mm256_add_ps(a, b); }
+		static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+		static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+		static V min(V a, V b) { return _mm256_min_ps(a, b); }
+		static V max(V a, V b) { return _mm256_max_ps(a, b); }
+		static V floor(V v)
+		{
+			return _mm256_round_ps(
+				v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+		}
+		static I to_int(V v) { return _mm256_cvttps_epi32(v); }
+		static V to_real(I v) { return _mm256_cvtepi32_ps(v); }
+
+		static I iset1(int v) { return _mm256_set1_epi32(v); }
+		static I iadd(I a, I b) { return _mm256_add_epi32(a, b); }
+		static I iand(I a, I b) { return _mm256_and_si256(a, b); }
+		static I ixor(I a, I b) { return _mm256_xor_si256(a, b); }
+		static I imul(I a, I b) { return _mm256_mullo_epi32(a, b); }
+		template <int n>
+		static I isrl(I v) { return _mm256_srli_epi32(v, n); }
+	};
+}
+
+int
+Noise::Kernel::worley_nearest_avx2(
+	const double *fx, const double *fy, const double *fz, const double *x,
+	const double *y, const double *z, double *f1, double *f2, int count
+) {
+	return worley_nearest<AVX2Double>(fx, fy, fz, x, y, z, f1, f2, count);
+}
+
+int
+Noise::Kernel::worley_nearest_avx2(
+	const float *fx, const float *fy, const float *fz, const float *x,
+	const float *y, const float *z, float *f1, float *f2, int count
+) {
+	return worley_nearest<AVX2Float>(fx, fy, fz, x, y, z, f1, f2, count);
+}
+
+int
+Noise::Kernel::worley_nearest_cells_avx2(
+	uint32_t seed, const double *x, const double *y, const double *z,
+	double *f1, double *f2, int count
+) {
+	return worley_nearest_cells<AVX2Double>(seed, x, y, z, f1, f2, count);
+}
+
+int
+Noise::Kernel::worley_nearest_cells_avx2(
+	uint32_t seed, const float *x, const float *y, const float *z,
+	float *f1, float *f2, int count
+) {
+	return worley_nearest_cells<AVX2Float>(seed, x, y, z, f1, f2, count);
+}
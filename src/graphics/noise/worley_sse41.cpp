@@ -0,0 +1,97 @@
+// Compiled with -msse4.1, only reached after a runtime CPU check.
+#include <smmintrin.h>
+#include <graphics/noise/simd.h>
+#include <graphics/noise/worley_kernel.h>
+
+namespace
+{
+	/// 2 doubles per vector, int lanes in the low 2 lanes of an __m128i.
+	struct SSE41Double
+	{
+		using Real = double;
+		using V = __m128d;
+		using I = __m128i;
+		static const int width = 2;
+
+		static V load(const double *p) { return _mm_loadu_pd(p); }
+		static void store(double *p, V v) { _mm_storeu_pd(p, v); }
+		static V set1(double v) { return _mm_set1_pd(v); }
+		static V add(V a, V b) { return _mm_add_pd(a, b); }
+		static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+		static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+		static V min(V a, V b) { return _mm_min_pd(a, b); }
+		static V max(V a, V b) { return _mm_max_pd(a, b); }
+		static V floor(V v)
+		{
+			return _mm_round_pd(
+				v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+		}
+		static I to_int(V v) { return _mm_cvttpd_epi32(v); }
+		static V to_real(I v) { return _mm_cvtepi32_pd(v); }
+
+		static I iset1(int v) { return _mm_set1_epi32(v); }
+		static I iadd(I a, I b) { return _mm_add_epi32(a, b); }
+		static I iand(I a, I b) { return _mm_and_si128(a, b); }
+		static I ixor(I a, I b) { return _mm_xor_si128(a, b); }
+		static I imul(I a, I b) { return _mm_mullo_epi32(a, b); }
+		template <int n>
+		static I isrl(I v) { return _mm_srli_epi32(v, n); }
+	};
+
+	/// 4 floats per vector, int lanes in the 4 lanes of an __m128i.
+	struct SSE41Float
+	{
+		using Real = float;
+		using V = __m128;
+		using I = __m128i;
+		static const int width = 4;
+
+		static V load(const float *p) { return _mm_loadu_ps(p); }
+		static void store(float *p, V v) { _mm_storeu_ps(p, v); }
+		static V set1(float v) { return _mm_set1_ps(v); }
+		static V add(V a, V b) { return _mm_add_ps(a, b); }
+		static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+		static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+		static V min(V a, V b) { return _mm_min_ps(a, b); }
+		static V max(V a, V b) { return _mm_max_ps(a, b); }
+		static V floor(V v)
+		{
+			return _mm_round_ps(
+				v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+		}
+		static I to_int(V v) { return _mm_cvttps_epi32(v); }
+		static V to_real(I v) { return _mm_cvtepi32_ps(v); }
+
+		static I iset1(int v) { return _mm_set1_epi32(v); }
+		static I iadd(I a, I b) { return _mm_add_epi32(a, b); }
+		static I iand(I a, I b) { return _mm_and_si128(a, b); }
+		static I ixor(I a, I b) { return _mm_xor_si128(a, b); }
+		static I imul(I a, I b) { return _mm_mullo_epi32(a, b); }
+		template <int n>
+		static I isrl(I v) { return _mm_srli_epi32(v, n); }
+	};
+}
+
+int
+Noise::Kernel::worley_nearest_sse41(
+	const double *fx, const double *fy, const double *fz, const double *x,
+	const double *y, const double *z, double *f1, double *f2, int count
+) {
+	return worley_nearest<SSE41Double>(fx, fy, fz, x, y, z, f1, f2, count);
+}
+
+int
+Noise::Kernel::worley_nearest_sse41(
+	const float *fx, const float *fy, const float *fz, const float *x,
+	const float *y, const float *z, float *f1, float *f2, int count
+) {
+	return worley_nearest<SSE41Float>(fx, fy, fz, x, y, z, f1, f2, count);
+}
+
+int
+Noise::Kernel::worley_nearest_cells_sse41(
+	uint32_t seed, const float *x, const float *y, const float *z,
+	float *f1, float *f2, int count
+) {
+	return worley_nearest_cells<SSE41Float>(seed, x, y, z, f1, f2, count);
+}
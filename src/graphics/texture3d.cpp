@@ -0,0 +1,49 @@
+#include <graphics/texture3d.h>
+
+Texture3D::Texture3D(
+	const float *data, int width, int height, int depth, FilterType filter
+):
+	identifier(0),
+	data(data),
+	width(width),
+	height(height),
+	depth(depth),
+	tex_filter(filter)
+{}
+
+Texture3D::~Texture3D()
+{
+	if (identifier)
+		glDeleteTextures(1, &identifier);
+}
+
+void
+Texture3D::load()
+{
+	GLenum gl_filter =
+		(tex_filter == filter_nearest) ? GL_NEAREST : GL_LINEAR;
+
+	glGenTextures(1, &identifier);
+	glBindTexture(GL_TEXTURE_3D, identifier);
+	glTexImage3D(
+		GL_TEXTURE_3D, 0, GL_R32F, width, height, depth, 0, GL_RED,
+		GL_FLOAT, data);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, gl_filter);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, gl_filter);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+}
+
+unsigned int
+Texture3D::id() const
+{
+	return identifier;
+}
+
+void
+Texture3D::use(GLenum tex_unit) const
+{
+	glActiveTexture(tex_unit);
+	glBindTexture(GL_TEXTURE_3D, identifier);
+}
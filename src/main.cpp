@@ -14,6 +14,7 @@
 #include <graphics/model.h>
 #include <graphics/material.h>
 #include <graphics/noise.h>
+#include <graphics/noise/chunk_noise.h>
 #include <graphics/volume.h>
 #include <graphics/primitives/cube.h>
 #include <graphics/primitives/plane.h>
@@ -80,6 +81,9 @@ Shader depth_map_shader(
 Shader depth_debug_shader(
 	"glsl/shadowmap_vertex_quad.glsl", "glsl/shadowmap_frag_quad.glsl");
 Shader white_shader("glsl/vertex.glsl", "glsl/white.glsl");
+MaterialShader voxel_mtl_shader("glsl/voxel_vertex.glsl");
+Shader voxel_depth_map_shader(
+	"glsl/shadowmap_voxel_vertex.glsl", "glsl/shadowmap_frag.glsl");
 
 // Depth map
 
@@ -107,7 +111,8 @@ DrawObjectsRenderPass draw_pass(
 constexpr const int cnk_v_cnt = 24;
 constexpr const double cnk_v_sz = 1.0f;
 
-using ChunkVolumeMesh = GFX::VolumeMesh<cnk_v_cnt, cnk_v_cnt, cnk_v_cnt>;
+using ChunkNoise = Noise::ChunkNoise<Noise::Perlin>;
+using ChunkVolumeMesh = GFX::StreamedVolumeMesh<Noise::ChunkDensitySlices>;
 
 GFX::CubeMesh cube_mesh(1.0f, 1.0f, 1.0f);
 
@@ -119,16 +124,9 @@ Noise::Image  heightmap(perlin, cnk_v_cnt, cnk_v_cnt, layout_rgb, 4.0f, 6, 0.45f
 Texture       heightmap_tex(&heightmap, layout_rgb, filter_nearest);
 Material      heightmap_mtl(&heightmap_tex, &heightmap_tex, 0.0f);
 
-// 3D Perlin
-Noise::Volume<cnk_v_cnt, cnk_v_cnt, cnk_v_cnt> perlin_volume(
-	perlin,	// Noise generator
-	4.0f, 	// Initial frequency
-	6, 		// Octave count
-	0.4f, 	// Persistence
-	0.6f);	// Threshold value for noise
-
-// 3D Perlin Volume
-GFX::Volume<cnk_v_cnt, cnk_v_cnt, cnk_v_cnt> chunk_volume;
+// Chunk noise by chunk coordinate, kept so that chunks coming back into
+// view aren't evaluated again
+Noise::ChunkCache chunk_cache(64 << 20);
 
 // Heightmap plane
 
@@ -293,6 +291,8 @@ main(void)
 		depth_map_shader.try_create_and_link();
 		depth_debug_shader.try_create_and_link();
 		white_shader.try_create_and_link();
+		voxel_mtl_shader.try_create_and_link();
+		voxel_depth_map_shader.try_create_and_link();
 		
 		ground_d.try_load();
 		
@@ -333,33 +333,26 @@ main(void)
 		return -1;
 	}
 
-	// Prepare terrain
-	for (int ix = 0; ix < cnk_v_cnt; ix++)
-	for (int iy = 0; iy < cnk_v_cnt; iy++)
-	for (int iz = 0; iz < cnk_v_cnt; iz++)
-	{
-		int sample = perlin_volume.sample(ix, iy, iz);
-		GFX::Voxel &voxel = chunk_volume.voxel_at(ix, iy, iz);
-		voxel.material = sample;
-
-		// if (voxel.material != 0)
-		// {
-		// 	glm::vec3 translation(
-		// 		(float)ix - (float)cnk_v_cnt / 2.0f,
-		// 		(float)iy - (float)cnk_v_cnt / 2.0f,
-		// 		(float)iz - (float)cnk_v_cnt / 2.0f);
-			
-		// 	auto cube_ptr = std::make_shared<Model>(
-		// 		&cube_mesh, &mtl_shader, &ground_mtl, translation);
-
-		// 	models.push_back(cube_ptr);
-		// }
-	}
-
-	ChunkVolumeMesh chunk_mesh(chunk_volume, 1.0f);
+	// Prepare terrain, 3D Perlin greedy meshed slice by slice into packed
+	// vertices
+	Noise::ChunkNoiseSettings chunk_settings;
+	chunk_settings.size = cnk_v_cnt;
+	chunk_settings.scale = 4.0f / cnk_v_cnt;	// Initial frequency
+	chunk_settings.octaves = 6;
+	chunk_settings.persistence = 0.4;
+	ChunkNoise chunk_noise(perlin, chunk_settings, chunk_cache);
+
+	Noise::ChunkDensitySlices chunk_slices(
+		chunk_noise.density(0, 0, 0), cnk_v_cnt,
+		0.6);	// Threshold value for noise
+	ChunkVolumeMesh chunk_mesh(
+		chunk_slices, 1.0f, 1, GFX::MeshingMode::Greedy,
+		GFX::VertexFormat::Packed32);
 	chunk_mesh.load();
 	auto chunk_model = std::make_shared<Model>(
-		&chunk_mesh, &mtl_shader, &ground_mtl, glm::vec3(0.0f, 0.0f, 0.0f));
+		&chunk_mesh, &voxel_mtl_shader, &ground_mtl,
+		glm::vec3(0.0f, 0.0f, 0.0f));
+	chunk_model->depth_shader = &voxel_depth_map_shader;
 	models.push_back(chunk_model);
 
 	// Main loop